@@ -0,0 +1,182 @@
+/*
+  ==============================================================================
+
+    Times the analyzer tap's cost on the audio thread: the span copy, the
+    sample-at-a-time loop it replaced, and the tap with no reader attached.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/SampleFifo.h"
+#include "BenchmarkHelpers.h"
+
+namespace
+{
+    using BlockType = juce::AudioBuffer<float>;
+
+    /** The tap as it was: every sample set on its own, with a check for a full buffer before each. */
+    struct SampleAtATimeFifo
+    {
+        void prepare (int bufferSize)
+        {
+            bufferToFill.setSize (1, bufferSize, false, true, true);
+            audioBufferFifo.prepare (1, bufferSize);
+            fifoIndex = 0;
+        }
+
+        void update (const BlockType& buffer)
+        {
+            auto* channelPtr = buffer.getReadPointer (Channel::Left);
+
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                pushNextSampleIntoFifo (channelPtr[i]);
+        }
+
+        bool getAudioBuffer (BlockType& buf) { return audioBufferFifo.pull (buf); }
+
+        void pushNextSampleIntoFifo (float sample)
+        {
+            if (fifoIndex == bufferToFill.getNumSamples())
+            {
+                auto ok = audioBufferFifo.push (bufferToFill);
+
+                juce::ignoreUnused (ok);
+
+                fifoIndex = 0;
+            }
+
+            bufferToFill.setSample (0, fifoIndex, sample);
+            ++fifoIndex;
+        }
+
+        int fifoIndex = 0;
+        Fifo<BlockType> audioBufferFifo;
+        BlockType bufferToFill;
+    };
+
+    /**
+     Feeds the tap numBlocks blocks of the given size, a few at a time so its
+     FIFO never fills, and returns the time spent in update() alone: the
+     reader's pulls in between are not timed.
+     */
+    template<typename Tap>
+    double timeUpdates (Tap& tap, const BlockType& block, int numBlocks)
+    {
+        //fewer than the FIFO holds, so every update copies as it would with the editor keeping up
+        static constexpr int blocksPerBatch = 16;
+
+        BlockType pulled;
+        juce::int64 total = 0;
+
+        for (int done = 0; done < numBlocks; done += blocksPerBatch)
+        {
+            auto start = juce::Time::getHighResolutionTicks();
+
+            for (int i = 0; i < blocksPerBatch; ++i)
+                tap.update (block);
+
+            total += juce::Time::getHighResolutionTicks() - start;
+
+            while (tap.getAudioBuffer (pulled))
+                ;
+        }
+
+        return juce::Time::highResolutionTicksToSeconds (total);
+    }
+
+    template<typename Tap>
+    double timeFastestUpdates (Tap& tap, const BlockType& block, int numBlocks)
+    {
+        auto best = std::numeric_limits<double>::max();
+
+        for (int run = 0; run < 5; ++run)
+            best = juce::jmin (best, timeUpdates (tap, block, numBlocks));
+
+        return best;
+    }
+
+    /** Formats a run's time as nanoseconds per block of the given size. */
+    juce::String formatTimePerBlock (double seconds, int numBlocks)
+    {
+        return juce::String (seconds * 1.0e9 / numBlocks, 1) + " ns/block";
+    }
+}
+
+class AnalyzerTapBenchmark : public juce::UnitTest
+{
+public:
+    AnalyzerTapBenchmark() : juce::UnitTest ("Analyzer tap", "SimpleEQ") {}
+
+    void runTest() override
+    {
+        beginTest ("Readers get the stream in order");
+
+        //blocks that do not divide the buffer, so spans are split at its boundaries
+        for (auto blockSize : { 100, 256, 300 })
+        {
+            static constexpr int bufferSize = 256;
+
+            SingleChannelSampleFifo<BlockType> tap { Channel::Left };
+            tap.prepare (bufferSize);
+            tap.attachConsumer();
+
+            BlockType block (2, blockSize), pulled;
+            int written = 0, read = 0, numMismatches = 0;
+
+            for (int n = 0; n < 20; ++n)
+            {
+                for (int i = 0; i < blockSize; ++i)
+                    block.setSample (Channel::Left, i, (float) written++);
+
+                tap.update (block);
+
+                while (tap.getAudioBuffer (pulled))
+                {
+                    expectEquals (pulled.getNumSamples(), bufferSize);
+
+                    for (int i = 0; i < pulled.getNumSamples(); ++i)
+                        if (pulled.getSample (0, i) != (float) read++)
+                            ++numMismatches;
+                }
+            }
+
+            expectEquals (numMismatches, 0, juce::String (blockSize) + "-sample blocks");
+            expect (written - read < bufferSize, "every full buffer was delivered");
+
+            tap.detachConsumer();
+        }
+
+        beginTest ("Timing");
+
+        for (auto blockSize : { 32, 256, 2048 })
+        {
+            //the processor prepares the taps for its largest block
+            BlockType block (2, blockSize);
+            fillWithNoise (block, 3);
+
+            //the same number of samples at each size
+            auto numBlocks = (1 << 20) / blockSize;
+
+            SingleChannelSampleFifo<BlockType> tap { Channel::Left };
+            tap.prepare (blockSize);
+
+            auto detachedTime = timeFastestUpdates (tap, block, numBlocks);
+
+            tap.attachConsumer();
+            auto spanTime = timeFastestUpdates (tap, block, numBlocks);
+            tap.detachConsumer();
+
+            SampleAtATimeFifo oldTap;
+            oldTap.prepare (blockSize);
+            auto sampleTime = timeFastestUpdates (oldTap, block, numBlocks);
+
+            logMessage (juce::String (blockSize) + "-sample blocks: sample at a time " + formatTimePerBlock (sampleTime, numBlocks)
+                        + ", spans " + formatTimePerBlock (spanTime, numBlocks)
+                        + " (" + juce::String (sampleTime / spanTime, 2) + "x)"
+                        + ", no reader " + formatTimePerBlock (detachedTime, numBlocks));
+        }
+    }
+};
+
+static AnalyzerTapBenchmark analyzerTapBenchmark;
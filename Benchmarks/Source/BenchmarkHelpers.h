@@ -0,0 +1,44 @@
+/*
+  ==============================================================================
+
+    Signals and timing shared by the benchmarks.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/** Fills every channel with white noise at half scale; the same seed gives the same noise. */
+template<typename SampleType>
+void fillWithNoise (juce::AudioBuffer<SampleType>& buffer, juce::int64 seed)
+{
+    juce::Random random (seed);
+
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        for (int i = 0; i < buffer.getNumSamples(); ++i)
+            buffer.setSample (ch, i, (SampleType) (random.nextFloat() - 0.5f));
+}
+
+/** Calls function numRuns times and returns the fastest run, in seconds. */
+template<typename Function>
+double timeFastestRun (int numRuns, Function&& function)
+{
+    auto best = std::numeric_limits<juce::int64>::max();
+
+    for (int run = 0; run < numRuns; ++run)
+    {
+        auto start = juce::Time::getHighResolutionTicks();
+        function();
+        best = juce::jmin (best, juce::Time::getHighResolutionTicks() - start);
+    }
+
+    return juce::Time::highResolutionTicksToSeconds (best);
+}
+
+/** Formats a run's time as nanoseconds per sample of one channel. */
+inline juce::String formatTimePerSample (double seconds, int numSamples)
+{
+    return juce::String (seconds * 1.0e9 / numSamples, 2) + " ns/sample";
+}
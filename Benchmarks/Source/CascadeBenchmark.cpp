@@ -0,0 +1,276 @@
+/*
+  ==============================================================================
+
+    Checks the SIMD biquad cascade against the chain of
+    juce::dsp::IIR::Filters it replaced, sample for sample, and times the two.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/BiquadCascade.h"
+#include "BenchmarkHelpers.h"
+
+namespace
+{
+    //the plugin's original chain, one per channel: a Butterworth low-cut, a peak and a Butterworth high-cut
+    using Filter = juce::dsp::IIR::Filter<float>;
+    using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
+    using MonoChain = juce::dsp::ProcessorChain<CutFilter, Filter, CutFilter>;
+    using CutDesign = juce::dsp::FilterDesign<float>::IIRCoefficientsArray;
+
+    struct Settings
+    {
+        float lowCutFreq, peakFreq, peakGainInDecibels, peakQuality, highCutFreq;
+        int lowCutOrder, highCutOrder;
+    };
+
+    //the original slopes ran from 12 to 48 dB/oct, so orders 2 to 8
+    const Settings settingsToCheck[]
+    {
+        { 20.0f,   750.0f,   0.0f,  1.0f,  20000.0f, 2, 2 },
+        { 80.0f,   1200.0f,  9.0f,  0.7f,  12000.0f, 4, 8 },
+        { 250.0f,  3000.0f,  -18.0f, 6.0f, 8000.0f,  8, 4 },
+        { 35.0f,   60.0f,    24.0f, 0.1f,  18000.0f, 6, 6 },
+        { 1000.0f, 15000.0f, -6.0f, 10.0f, 19000.0f, 8, 8 }
+    };
+
+    constexpr double sampleRate = 48000.0;
+
+    template<int Index>
+    void setCutSection (CutFilter& cut, const CutDesign& design)
+    {
+        auto isActive = Index < design.size();
+        cut.template setBypassed<Index> (! isActive);
+
+        if (isActive)
+            *cut.template get<Index>().coefficients = *design[Index];
+    }
+
+    void setCut (CutFilter& cut, const CutDesign& design)
+    {
+        setCutSection<0> (cut, design);
+        setCutSection<1> (cut, design);
+        setCutSection<2> (cut, design);
+        setCutSection<3> (cut, design);
+    }
+
+    void setFilterChain (MonoChain& chain, const Settings& settings)
+    {
+        setCut (chain.get<0>(), juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod (settings.lowCutFreq, sampleRate, settings.lowCutOrder));
+
+        *chain.get<1>().coefficients = *juce::dsp::IIR::Coefficients<float>::makePeakFilter (sampleRate, settings.peakFreq, settings.peakQuality,
+                                                                                             juce::Decibels::decibelsToGain (settings.peakGainInDecibels));
+
+        setCut (chain.get<2>(), juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod (settings.highCutFreq, sampleRate, settings.highCutOrder));
+    }
+
+    ChainCoefficients<float> designCascadeChain (const Settings& settings)
+    {
+        ChainCoefficients<float> chain;
+        designHighPassCut (chain.lowCut, Cut_Butterworth, settings.lowCutFreq, sampleRate, settings.lowCutOrder);
+
+        chain.bands.numSections = 1;
+        chain.bands.sections[0] = makePeakBiquad (sampleRate, settings.peakFreq, settings.peakQuality,
+                                                  juce::Decibels::decibelsToGain (settings.peakGainInDecibels));
+
+        designLowPassCut (chain.highCut, Cut_Butterworth, settings.highCutFreq, sampleRate, settings.highCutOrder);
+        return chain;
+    }
+
+    const char* getModeName (CascadeMode mode)
+    {
+        switch (mode)
+        {
+            case CascadeMode::automatic:      return "automatic";
+            case CascadeMode::fused:          return "fused";
+            case CascadeMode::stageByStage:   return "stage by stage";
+            case CascadeMode::acrossSections: return "across sections";
+            case CascadeMode::stateSpace:     return "state space";
+        }
+
+        return "";
+    }
+
+    /** Runs the two through blocks of uneven sizes, so the state carried from one block to the next is checked too. */
+    struct Comparison
+    {
+        Comparison (int numChannelsToUse, int numSamplesToUse)
+            : numChannels (numChannelsToUse), numSamples (numSamplesToUse),
+              filterChains ((size_t) numChannelsToUse)
+        {
+            juce::dsp::ProcessSpec spec { sampleRate, (juce::uint32) maximumBlockSize, 1 };
+
+            for (auto& chain : filterChains)
+                chain.prepare (spec);
+
+            spec.numChannels = (juce::uint32) numChannels;
+            cascade.prepare (spec);
+
+            input.setSize (numChannels, numSamples);
+            fillWithNoise (input, 1234);
+        }
+
+        /** Starts both from silence, since they carry state across a change in slope differently. */
+        void setSettings (const Settings& settings)
+        {
+            for (auto& chain : filterChains)
+            {
+                setFilterChain (chain, settings);
+                chain.reset();
+            }
+
+            cascade.setCoefficients (designCascadeChain (settings));
+            cascade.reset();
+        }
+
+        void runFilterChains (juce::AudioBuffer<float>& buffer)
+        {
+            buffer.makeCopyOf (input);
+            juce::dsp::AudioBlock<float> block (buffer);
+
+            forEachBlock ([&] (int start, int length)
+            {
+                for (int ch = 0; ch < numChannels; ++ch)
+                {
+                    auto channelBlock = block.getSingleChannelBlock ((size_t) ch).getSubBlock ((size_t) start, (size_t) length);
+                    juce::dsp::ProcessContextReplacing<float> context (channelBlock);
+                    filterChains[(size_t) ch].process (context);
+                }
+            });
+        }
+
+        void runCascade (juce::AudioBuffer<float>& buffer)
+        {
+            buffer.makeCopyOf (input);
+            juce::dsp::AudioBlock<float> block (buffer);
+
+            forEachBlock ([&] (int start, int length)
+            {
+                cascade.process (block.getSubBlock ((size_t) start, (size_t) length));
+            });
+        }
+
+        template<typename Function>
+        void forEachBlock (Function&& function)
+        {
+            static constexpr int blockSizes[] { 512, 37, 1, 256, 1023, 64 };
+
+            for (int start = 0, block = 0; start < numSamples; ++block)
+            {
+                auto length = juce::jmin (blockSizes[(size_t) block % std::size (blockSizes)], numSamples - start);
+                function (start, length);
+                start += length;
+            }
+        }
+
+        static constexpr int maximumBlockSize = 1024;
+
+        const int numChannels, numSamples;
+        std::vector<MonoChain> filterChains;
+        MultiChannelBiquadCascade<float> cascade;
+        juce::AudioBuffer<float> input;
+    };
+
+    int countDifferentSamples (const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+    {
+        int numDifferent = 0;
+
+        for (int ch = 0; ch < a.getNumChannels(); ++ch)
+            for (int i = 0; i < a.getNumSamples(); ++i)
+                if (std::memcmp (a.getReadPointer (ch, i), b.getReadPointer (ch, i), sizeof (float)) != 0)
+                    ++numDifferent;
+
+        return numDifferent;
+    }
+}
+
+class CascadeBenchmark : public juce::UnitTest
+{
+public:
+    CascadeBenchmark() : juce::UnitTest ("Biquad cascade against IIR::Filter", "SimpleEQ") {}
+
+    void runTest() override
+    {
+        beginTest ("Designs match IIR::Coefficients and FilterDesign");
+
+        for (const auto& settings : settingsToCheck)
+        {
+            MonoChain filterChain;
+            setFilterChain (filterChain, settings);
+            auto cascadeChain = designCascadeChain (settings);
+
+            expectMatches (cascadeChain.bands.sections[0], *filterChain.get<1>().coefficients);
+
+            auto lowCut = juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod (settings.lowCutFreq, sampleRate, settings.lowCutOrder);
+            expectEquals (cascadeChain.lowCut.numSections, lowCut.size());
+            for (int i = 0; i < lowCut.size(); ++i)
+                expectMatches (cascadeChain.lowCut.sections[(size_t) i], *lowCut[i]);
+
+            auto highCut = juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod (settings.highCutFreq, sampleRate, settings.highCutOrder);
+            expectEquals (cascadeChain.highCut.numSections, highCut.size());
+            for (int i = 0; i < highCut.size(); ++i)
+                expectMatches (cascadeChain.highCut.sections[(size_t) i], *highCut[i]);
+        }
+
+        beginTest ("Output is bit-identical");
+
+        //one lane, a register shared by a pair, and enough channels for the dispatched kernel
+        for (auto numChannels : { 1, 2, 6 })
+        {
+            //automatic mode only leaves the cascade's kernels offline
+            std::vector<CascadeMode> modes { CascadeMode::automatic, CascadeMode::fused, CascadeMode::stageByStage };
+            if (numChannels == 1)
+                modes.push_back (CascadeMode::acrossSections);
+
+            for (auto mode : modes)
+            {
+                Comparison comparison (numChannels, 8192);
+                comparison.cascade.setMode (mode);
+
+                juce::AudioBuffer<float> expected, actual;
+
+                for (const auto& settings : settingsToCheck)
+                {
+                    comparison.setSettings (settings);
+                    comparison.runFilterChains (expected);
+                    comparison.runCascade (actual);
+
+                    expectEquals (countDifferentSamples (expected, actual), 0,
+                                  juce::String (numChannels) + " channels, " + getModeName (mode));
+                }
+            }
+        }
+
+        beginTest ("Timing");
+
+        for (auto numChannels : { 1, 2, 8 })
+        {
+            static constexpr int numSamples = 1 << 16;
+
+            Comparison comparison (numChannels, numSamples);
+            comparison.setSettings (settingsToCheck[4]);
+
+            juce::AudioBuffer<float> output;
+            auto filterChainTime = timeFastestRun (5, [&] { comparison.runFilterChains (output); });
+            auto cascadeTime = timeFastestRun (5, [&] { comparison.runCascade (output); });
+
+            auto numChannelSamples = numSamples * numChannels;
+            logMessage (juce::String (numChannels) + " channels, steepest cuts: IIR::Filter chain "
+                        + formatTimePerSample (filterChainTime, numChannelSamples)
+                        + ", cascade " + formatTimePerSample (cascadeTime, numChannelSamples)
+                        + ", " + juce::String (filterChainTime / cascadeTime, 2) + "x");
+        }
+    }
+
+private:
+    void expectMatches (const BiquadCoefficients<float>& actual, const juce::dsp::IIR::Coefficients<float>& expected)
+    {
+        BiquadCoefficients<float> copied;
+        copyCoefficients (copied, expected);
+
+        expect (std::memcmp (&actual, &copied, sizeof (copied)) == 0, "coefficients differ");
+    }
+};
+
+static CascadeBenchmark cascadeBenchmark;
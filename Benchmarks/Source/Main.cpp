@@ -0,0 +1,33 @@
+/*
+  ==============================================================================
+
+    Runs the DSP checks and benchmarks. Give a test's name to run that one
+    alone; the exit code is non-zero if any check failed.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+int main (int argc, char* argv[])
+{
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure (false);
+
+    if (argc > 1)
+    {
+        for (auto* test : juce::UnitTest::getTestsInCategory ("SimpleEQ"))
+            if (test->getName() == argv[1])
+                runner.runTests ({ test });
+    }
+    else
+    {
+        runner.runTestsInCategory ("SimpleEQ");
+    }
+
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        if (runner.getResult (i)->failures > 0)
+            return 1;
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*
+  ==============================================================================
+
+    Checks that only the offline switch puts the cascade on its state-space
+    kernel, measures how far that kernel's output is from the per-sample
+    recursion's, and times the two from small blocks to offline-sized ones.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/BiquadCascade.h"
+#include "BenchmarkHelpers.h"
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+
+    /** Steep cuts either side of a handful of bells and shelves, as a busy session might have. */
+    template<typename SampleType>
+    ChainCoefficients<SampleType> designBusyChain()
+    {
+        ChainCoefficients<SampleType> chain;
+        designHighPassCut (chain.lowCut, Cut_Butterworth, (SampleType) 40, sampleRate, 8);
+        designLowPassCut (chain.highCut, Cut_LinkwitzRiley, (SampleType) 16000, sampleRate, 8);
+
+        const BandType types[] { Band_LowShelf, Band_Bell, Band_Bell, Band_Notch, Band_Bell, Band_HighShelf };
+
+        for (int band = 0; band < (int) std::size (types); ++band)
+        {
+            auto frequency = (SampleType) (80.0 * std::pow (2.5, band));
+            auto gain = (SampleType) (band % 2 == 0 ? 6 : -9);
+
+            chain.bands.sections[(size_t) band] = makeBandBiquad (types[band], sampleRate, frequency, (SampleType) 1.4, gain);
+            chain.bands.bandIndices[(size_t) band] = band;
+        }
+
+        chain.bands.numSections = (int) std::size (types);
+        return chain;
+    }
+
+    /** A cascade prepared for one block size, that filters whole buffers a block at a time. */
+    template<typename SampleType>
+    struct Renderer
+    {
+        Renderer (int numChannels, int blockSizeToUse, CascadeMode mode, bool offline)
+            : blockSize (blockSizeToUse)
+        {
+            cascade.prepare ({ sampleRate, (juce::uint32) blockSize, (juce::uint32) numChannels });
+            cascade.setMode (mode);
+            cascade.setRenderingOffline (offline);
+            cascade.setCoefficients (designBusyChain<SampleType>());
+        }
+
+        /** Filters the buffer in place, from silence. */
+        void process (juce::AudioBuffer<SampleType>& buffer)
+        {
+            cascade.reset();
+            juce::dsp::AudioBlock<SampleType> block (buffer);
+
+            for (int start = 0; start < buffer.getNumSamples(); start += blockSize)
+                cascade.process (block.getSubBlock ((size_t) start, (size_t) juce::jmin (blockSize, buffer.getNumSamples() - start)));
+        }
+
+        const int blockSize;
+        MultiChannelBiquadCascade<SampleType> cascade;
+    };
+
+    template<typename SampleType>
+    juce::AudioBuffer<SampleType> render (const juce::AudioBuffer<SampleType>& input, int blockSize,
+                                          CascadeMode mode, bool offline)
+    {
+        juce::AudioBuffer<SampleType> output;
+        output.makeCopyOf (input);
+
+        Renderer<SampleType> (input.getNumChannels(), blockSize, mode, offline).process (output);
+        return output;
+    }
+
+    template<typename SampleType>
+    bool areIdentical (const juce::AudioBuffer<SampleType>& a, const juce::AudioBuffer<SampleType>& b)
+    {
+        for (int ch = 0; ch < a.getNumChannels(); ++ch)
+            if (std::memcmp (a.getReadPointer (ch), b.getReadPointer (ch), sizeof (SampleType) * (size_t) a.getNumSamples()) != 0)
+                return false;
+
+        return true;
+    }
+
+    template<typename SampleType>
+    double getLargestDifference (const juce::AudioBuffer<SampleType>& a, const juce::AudioBuffer<SampleType>& b)
+    {
+        double largest = 0;
+
+        for (int ch = 0; ch < a.getNumChannels(); ++ch)
+            for (int i = 0; i < a.getNumSamples(); ++i)
+                largest = juce::jmax (largest, (double) std::abs (a.getReadPointer (ch)[i] - b.getReadPointer (ch)[i]));
+
+        return largest;
+    }
+}
+
+class StateSpaceBenchmark : public juce::UnitTest
+{
+public:
+    StateSpaceBenchmark() : juce::UnitTest ("State-space kernel against the cascade", "SimpleEQ") {}
+
+    void runTest() override
+    {
+        //mono, a pair sharing a register, and a bus of several registers
+        static constexpr int channelCounts[] { 1, 2, 6 };
+        static constexpr int blockSizes[] { 32, 256, 2048, 8192 };
+
+        beginTest ("Automatic mode follows the offline switch alone");
+
+        for (auto numChannels : channelCounts)
+        {
+            juce::AudioBuffer<float> input (numChannels, 1 << 15);
+            fillWithNoise (input, 99);
+
+            for (auto blockSize : blockSizes)
+            {
+                auto name = juce::String (numChannels) + " channels, " + juce::String (blockSize) + " samples";
+
+                expect (areIdentical (render (input, blockSize, CascadeMode::automatic, false),
+                                      render (input, blockSize, CascadeMode::fused, false)), name + ", realtime");
+
+                auto offline = render (input, blockSize, CascadeMode::automatic, true);
+                expect (areIdentical (offline, render (input, blockSize, CascadeMode::automatic, true)), name + ", offline twice");
+                expect (areIdentical (offline, render (input, blockSize, CascadeMode::stateSpace, false)), name + ", offline");
+            }
+        }
+
+        beginTest ("Output is close to the cascade's");
+
+        checkAccuracy();
+
+        beginTest ("Timing");
+
+        for (auto numChannels : channelCounts)
+        {
+            for (auto blockSize : blockSizes)
+            {
+                juce::AudioBuffer<float> buffer (numChannels, 1 << 16);
+                fillWithNoise (buffer, 7);
+
+                Renderer<float> realtime (numChannels, blockSize, CascadeMode::automatic, false);
+                Renderer<float> offline (numChannels, blockSize, CascadeMode::automatic, true);
+
+                auto cascadeTime = timeFastestRun (5, [&] { realtime.process (buffer); });
+                auto stateSpaceTime = timeFastestRun (5, [&] { offline.process (buffer); });
+
+                auto numChannelSamples = buffer.getNumSamples() * numChannels;
+                logMessage (juce::String (numChannels) + " channels, " + juce::String (blockSize) + "-sample blocks: cascade "
+                            + formatTimePerSample (cascadeTime, numChannelSamples)
+                            + ", state-space " + formatTimePerSample (stateSpaceTime, numChannelSamples)
+                            + ", " + juce::String (cascadeTime / stateSpaceTime, 2) + "x");
+            }
+        }
+    }
+
+private:
+    /**
+     Measures both kernels against the cascade run in double; the state-space
+     kernel may round differently, but should be no less accurate.
+     */
+    void checkAccuracy()
+    {
+        juce::AudioBuffer<double> input (2, 1 << 15);
+        fillWithNoise (input, 5);
+
+        juce::AudioBuffer<float> floatInput;
+        floatInput.makeCopyOf (input);
+
+        auto reference = render (input, 2048, CascadeMode::fused, false);
+
+        auto getError = [&] (CascadeMode mode)
+        {
+            juce::AudioBuffer<double> output;
+            output.makeCopyOf (render (floatInput, 2048, mode, false));
+            return getLargestDifference (output, reference);
+        };
+
+        auto cascadeError = getError (CascadeMode::fused);
+        auto stateSpaceError = getError (CascadeMode::stateSpace);
+
+        logMessage ("largest error in float: cascade " + juce::String (cascadeError, 9)
+                    + ", state-space " + juce::String (stateSpaceError, 9));
+        expectLessThan (stateSpaceError, cascadeError * 2);
+    }
+};
+
+static StateSpaceBenchmark stateSpaceBenchmark;
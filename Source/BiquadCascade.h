@@ -0,0 +1,1445 @@
+/*
+  ==============================================================================
+
+    A biquad cascade that filters several channels at once, one channel per
+    SIMD lane, from a shared set of coefficients, or with the second channel
+    of a pair (or the side of a mid/side pair) on a chain of its own.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FilterCoefficients.h"
+#include "CpuDispatch.h"
+#include "ParallelBiquads.h"
+#include "WorkStealingPool.h"
+
+template<typename VectorType>
+struct BiquadSection
+{
+    VectorType b0, b1, b2, a1, a2;
+};
+
+template<typename VectorType>
+struct BiquadState
+{
+    VectorType s1, s2;
+};
+
+template<typename SampleType>
+void snapToZero (SampleType& value)
+{
+    if (! (value < -1.0e-8f || value > 1.0e-8f))
+        value = 0;
+}
+
+template<typename SampleType>
+void snapToZero (juce::dsp::SIMDRegister<SampleType>& value)
+{
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        auto lane = value.get (i);
+        snapToZero (lane);
+        value.set (i, lane);
+    }
+}
+
+/**
+ Runs NumSections biquads in series, one sample at a time, with every
+ section's state held in locals for the whole block. The section count is a
+ template parameter so the inner loop is fully unrolled and has no branches;
+ processCascadeInPasses() keeps it small enough for the states to stay in
+ registers.
+
+ Each section is transposed direct form II with the operations in exactly the
+ order juce::dsp::IIR::Filter uses, so every lane is bit-identical to a chain
+ of Filters running on that channel alone.
+ */
+template<int NumSections, typename VectorType>
+void processCascade (VectorType* samples,
+                     size_t numSamples,
+                     const BiquadSection<VectorType>* sections,
+                     BiquadState<VectorType>* states)
+{
+    if constexpr (NumSections > 0)
+    {
+        VectorType s1[NumSections], s2[NumSections];
+        for (int k = 0; k < NumSections; ++k)
+        {
+            s1[k] = states[k].s1;
+            s2[k] = states[k].s2;
+        }
+
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            auto input = samples[i];
+
+            for (int k = 0; k < NumSections; ++k)
+            {
+                const auto& c = sections[k];
+                auto output = input * c.b0 + s1[k];
+                s1[k] = (input * c.b1) - (output * c.a1) + s2[k];
+                s2[k] = (input * c.b2) - (output * c.a2);
+                input = output;
+            }
+
+            samples[i] = input;
+        }
+
+        for (int k = 0; k < NumSections; ++k)
+        {
+            snapToZero (s1[k]);
+            snapToZero (s2[k]);
+            states[k] = { s1[k], s2[k] };
+        }
+    }
+    else
+    {
+        juce::ignoreUnused (samples, numSamples, sections, states);
+    }
+}
+
+/**
+ Runs numSections biquads in series over one channel with the sections spread
+ across the lanes of a SIMDRegister, so one instruction advances a register's
+ worth of sections at once. It is a wavefront: while lane 0 takes in sample n,
+ lane j works on sample n - j, which lane j - 1 finished the step before.
+
+ The block passes through one register's worth of sections at a time. The
+ first and last few steps of each pass, where the wavefront is still filling
+ or draining, are done lane by lane, so no lane ever runs ahead of its input.
+ Each lane does exactly the operations processCascade() does, in the same order.
+ */
+template<typename SampleType>
+void processAcrossSections (SampleType* samples,
+                            size_t numSamples,
+                            const BiquadSection<SampleType>* sections,
+                            BiquadState<SampleType>* states,
+                            int numSections)
+{
+    using Register = juce::dsp::SIMDRegister<SampleType>;
+    constexpr auto numLanes = Register::SIMDNumElements;
+
+    if (numSamples == 0)
+        return;
+
+    for (int first = 0; first < numSections; first += (int) numLanes)
+    {
+        auto numPassSections = (size_t) juce::jmin ((int) numLanes, numSections - first);
+
+        //one coefficient or state of every section in the pass per register;
+        //idle lanes hold a section that passes its input straight through
+        alignas (Register::SIMDRegisterSize) SampleType b0[numLanes], b1[numLanes] = {}, b2[numLanes] = {},
+                                                        a1[numLanes] = {}, a2[numLanes] = {},
+                                                        s1[numLanes] = {}, s2[numLanes] = {};
+        std::fill (b0, b0 + numLanes, (SampleType) 1);
+
+        for (size_t lane = 0; lane < numPassSections; ++lane)
+        {
+            const auto& c = sections[(size_t) first + lane];
+            b0[lane] = c.b0, b1[lane] = c.b1, b2[lane] = c.b2, a1[lane] = c.a1, a2[lane] = c.a2;
+            s1[lane] = states[(size_t) first + lane].s1;
+            s2[lane] = states[(size_t) first + lane].s2;
+        }
+
+        const auto vb0 = Register::fromRawArray (b0), vb1 = Register::fromRawArray (b1), vb2 = Register::fromRawArray (b2);
+        const auto va1 = Register::fromRawArray (a1), va2 = Register::fromRawArray (a2);
+        auto vs1 = Register::fromRawArray (s1), vs2 = Register::fromRawArray (s2);
+
+        //what each lane takes in on this step, and what each gave out
+        alignas (Register::SIMDRegisterSize) SampleType inputs[numLanes] = {}, outputs[numLanes] = {};
+
+        for (size_t step = 0; step < numSamples + numLanes - 1; ++step)
+        {
+            if (step < numSamples)
+                inputs[0] = samples[step];
+
+            if (step >= numLanes - 1 && step < numSamples)
+            {
+                auto input = Register::fromRawArray (inputs);
+                auto output = input * vb0 + vs1;
+                vs1 = (input * vb1) - (output * va1) + vs2;
+                vs2 = (input * vb2) - (output * va2);
+                output.copyToRawArray (outputs);
+            }
+            else
+            {
+                //only the lanes that have a sample of their own may move
+                vs1.copyToRawArray (s1);
+                vs2.copyToRawArray (s2);
+
+                for (size_t lane = 0; lane < numLanes; ++lane)
+                {
+                    if (lane > step || step - lane >= numSamples)
+                        continue;
+
+                    auto input = inputs[lane];
+                    auto output = input * b0[lane] + s1[lane];
+                    s1[lane] = (input * b1[lane]) - (output * a1[lane]) + s2[lane];
+                    s2[lane] = (input * b2[lane]) - (output * a2[lane]);
+                    outputs[lane] = output;
+                }
+
+                vs1 = Register::fromRawArray (s1);
+                vs2 = Register::fromRawArray (s2);
+            }
+
+            //the last lane finishes the sample that entered numLanes - 1 steps ago
+            if (step >= numLanes - 1)
+                samples[step - (numLanes - 1)] = outputs[numLanes - 1];
+
+            for (size_t lane = numLanes - 1; lane > 0; --lane)
+                inputs[lane] = outputs[lane - 1];
+        }
+
+        vs1.copyToRawArray (s1);
+        vs2.copyToRawArray (s2);
+
+        for (size_t lane = 0; lane < numPassSections; ++lane)
+        {
+            snapToZero (s1[lane]);
+            snapToZero (s2[lane]);
+            states[(size_t) first + lane] = { s1[lane], s2[lane] };
+        }
+    }
+}
+
+/**
+ One biquad as a state-space system, advanced a register's worth of samples
+ per step. The outputs of a whole block come from the state at its start and
+ the inputs within it, as one weighted sum of registers, so the recursion is
+ taken once per block rather than once per sample.
+
+ The weights are powers of the state matrix, designed in double. Their
+ rounding differs from the per-sample recursion's, so the output is close to
+ processCascade()'s but not bit-identical.
+ */
+template<typename SampleType>
+struct StateSpaceSection
+{
+    using Register = juce::dsp::SIMDRegister<SampleType>;
+    static constexpr size_t blockLength = Register::SIMDNumElements;
+
+    //each output of the block from the two states at its start, and from each of its inputs
+    Register fromS1, fromS2;
+    std::array<Register, blockLength> fromInput;
+
+    //the states at the end of the block, likewise
+    SampleType s1FromS1, s1FromS2, s2FromS1, s2FromS2;
+    std::array<SampleType, blockLength> s1FromInput, s2FromInput;
+
+    //the samples after the last whole block run the plain recursion
+    BiquadCoefficients<SampleType> coefficients;
+
+    static StateSpaceSection design (const BiquadCoefficients<SampleType>& c)
+    {
+        //with state (s1, s2): A = [-a1 1; -a2 0], B = [b1 - a1 b0; b2 - a2 b0], C = [1 0], D = b0
+        using Matrix = std::array<std::array<double, 2>, 2>;
+        const double b0 = c.b0, b1 = c.b1, b2 = c.b2, a1 = c.a1, a2 = c.a2;
+        const Matrix a { { { -a1, 1 }, { -a2, 0 } } };
+        const std::array<double, 2> b { b1 - a1 * b0, b2 - a2 * b0 };
+
+        //powers[k] = A^k
+        std::array<Matrix, blockLength + 1> powers;
+        powers[0] = { { { 1, 0 }, { 0, 1 } } };
+        for (size_t k = 1; k <= blockLength; ++k)
+            for (size_t row = 0; row < 2; ++row)
+                for (size_t column = 0; column < 2; ++column)
+                    powers[k][row][column] = powers[k - 1][row][0] * a[0][column] + powers[k - 1][row][1] * a[1][column];
+
+        auto applyToB = [&] (size_t power, size_t row) { return powers[power][row][0] * b[0] + powers[power][row][1] * b[1]; };
+
+        //the impulse response: D, then C A^(m - 1) B
+        std::array<double, blockLength> impulse;
+        impulse[0] = b0;
+        for (size_t m = 1; m < blockLength; ++m)
+            impulse[m] = applyToB (m - 1, 0);
+
+        alignas (Register::SIMDRegisterSize) SampleType lanes[blockLength];
+        auto toRegister = [&lanes] (auto&& valueAt)
+        {
+            for (size_t k = 0; k < blockLength; ++k)
+                lanes[k] = (SampleType) valueAt (k);
+
+            return Register::fromRawArray (lanes);
+        };
+
+        StateSpaceSection section;
+        section.fromS1 = toRegister ([&] (size_t k) { return powers[k][0][0]; });
+        section.fromS2 = toRegister ([&] (size_t k) { return powers[k][0][1]; });
+
+        for (size_t i = 0; i < blockLength; ++i)
+        {
+            section.fromInput[i] = toRegister ([&] (size_t k) { return k >= i ? impulse[k - i] : 0.0; });
+            section.s1FromInput[i] = (SampleType) applyToB (blockLength - 1 - i, 0);
+            section.s2FromInput[i] = (SampleType) applyToB (blockLength - 1 - i, 1);
+        }
+
+        section.s1FromS1 = (SampleType) powers[blockLength][0][0];
+        section.s1FromS2 = (SampleType) powers[blockLength][0][1];
+        section.s2FromS1 = (SampleType) powers[blockLength][1][0];
+        section.s2FromS2 = (SampleType) powers[blockLength][1][1];
+        section.coefficients = c;
+        return section;
+    }
+
+    void process (SampleType* samples, size_t numSamples, BiquadState<SampleType>& state) const
+    {
+        auto s1 = state.s1, s2 = state.s2;
+        alignas (Register::SIMDRegisterSize) SampleType inputs[blockLength], outputs[blockLength];
+
+        size_t i = 0;
+        for (; i + blockLength <= numSamples; i += blockLength)
+        {
+            std::copy (samples + i, samples + i + blockLength, inputs);
+
+            auto output = fromS1 * s1 + fromS2 * s2;
+            auto nextS1 = s1FromS1 * s1 + s1FromS2 * s2;
+            auto nextS2 = s2FromS1 * s1 + s2FromS2 * s2;
+
+            for (size_t k = 0; k < blockLength; ++k)
+            {
+                output += fromInput[k] * inputs[k];
+                nextS1 += s1FromInput[k] * inputs[k];
+                nextS2 += s2FromInput[k] * inputs[k];
+            }
+
+            output.copyToRawArray (outputs);
+            std::copy (outputs, outputs + blockLength, samples + i);
+            s1 = nextS1;
+            s2 = nextS2;
+        }
+
+        const auto& c = coefficients;
+        for (; i < numSamples; ++i)
+        {
+            auto input = samples[i];
+            auto output = input * c.b0 + s1;
+            s1 = (input * c.b1) - (output * c.a1) + s2;
+            s2 = (input * c.b2) - (output * c.a2);
+            samples[i] = output;
+        }
+
+        snapToZero (s1);
+        snapToZero (s2);
+        state = { s1, s2 };
+    }
+};
+
+//the most sections one pass of processCascade() takes: their states still fit the register file alongside the coefficients
+static constexpr int maxFusedSections = 4;
+
+/**
+ Runs numSections biquads in series as passes of up to maxFusedSections
+ sections each, as KernelTable's cascades do. Every section sees the same
+ input it would in a single pass, so the output is the same bit for bit,
+ and only the counts up to maxFusedSections are ever instantiated.
+ */
+template<typename VectorType>
+void processCascadeInPasses (VectorType* samples,
+                             size_t numSamples,
+                             const BiquadSection<VectorType>* sections,
+                             BiquadState<VectorType>* states,
+                             int numSections)
+{
+    int k = 0;
+    for (; k + maxFusedSections <= numSections; k += maxFusedSections)
+        processCascade<maxFusedSections> (samples, numSamples, sections + k, states + k);
+
+    switch (numSections - k)
+    {
+        case 3: processCascade<3> (samples, numSamples, sections + k, states + k); break;
+        case 2: processCascade<2> (samples, numSamples, sections + k, states + k); break;
+        case 1: processCascade<1> (samples, numSamples, sections + k, states + k); break;
+        default: break;
+    }
+}
+
+enum class CascadeMode
+{
+    automatic,      //stateSpace offline; otherwise whichever of the others prepare() timed fastest at the block size
+    fused,          //every active section in one pass over the block
+    stageByStage,   //one pass per stage: low-cut, bands, high-cut
+    acrossSections, //mono only: the sections spread across the SIMD lanes
+    stateSpace      //a register's worth of samples per step, one channel at a time; mid/side runs fused
+};
+
+template<typename VectorType>
+struct VectorElement { using Type = VectorType; };
+
+template<typename SampleType>
+struct VectorElement<juce::dsp::SIMDRegister<SampleType>> { using Type = SampleType; };
+
+template<typename VectorType>
+VectorType splat (typename VectorElement<VectorType>::Type value)
+{
+    if constexpr (std::is_arithmetic_v<VectorType>)
+        return value;
+    else
+        return VectorType::expand (value);
+}
+
+/** Packs up to one register's worth of the block's channels, from firstChannel on, into one register per sample. */
+template<typename SampleType>
+void interleaveChannels (const juce::dsp::AudioBlock<SampleType>& block, size_t firstChannel, size_t numGroupChannels,
+                         juce::dsp::SIMDRegister<SampleType>* interleaved)
+{
+    using Register = juce::dsp::SIMDRegister<SampleType>;
+
+    alignas (Register::SIMDRegisterSize) SampleType lanes[Register::SIMDNumElements] = {};
+    const SampleType* channels[Register::SIMDNumElements] = {};
+
+    for (size_t ch = 0; ch < numGroupChannels; ++ch)
+        channels[ch] = block.getChannelPointer (firstChannel + ch);
+
+    for (size_t i = 0; i < block.getNumSamples(); ++i)
+    {
+        for (size_t ch = 0; ch < numGroupChannels; ++ch)
+            lanes[ch] = channels[ch][i];
+
+        interleaved[i] = Register::fromRawArray (lanes);
+    }
+}
+
+/** The reverse of interleaveChannels(). */
+template<typename SampleType>
+void deinterleaveChannels (const juce::dsp::SIMDRegister<SampleType>* interleaved,
+                           const juce::dsp::AudioBlock<SampleType>& block, size_t firstChannel, size_t numGroupChannels)
+{
+    using Register = juce::dsp::SIMDRegister<SampleType>;
+
+    alignas (Register::SIMDRegisterSize) SampleType lanes[Register::SIMDNumElements];
+    SampleType* channels[Register::SIMDNumElements] = {};
+
+    for (size_t ch = 0; ch < numGroupChannels; ++ch)
+        channels[ch] = block.getChannelPointer (firstChannel + ch);
+
+    for (size_t i = 0; i < block.getNumSamples(); ++i)
+    {
+        interleaved[i].copyToRawArray (lanes);
+
+        for (size_t ch = 0; ch < numGroupChannels; ++ch)
+            channels[ch][i] = lanes[ch];
+    }
+}
+
+/**
+ As interleaveChannels() for a stereo pair, encoding it on the way in: lane 0
+ takes the mid, (left + right) / 2, and lane 1 the side, (left - right) / 2.
+ */
+template<typename SampleType>
+void interleaveMidSide (const juce::dsp::AudioBlock<SampleType>& block, juce::dsp::SIMDRegister<SampleType>* interleaved)
+{
+    using Register = juce::dsp::SIMDRegister<SampleType>;
+    static_assert (Register::SIMDNumElements >= 2, "Mid and side need a lane each");
+
+    alignas (Register::SIMDRegisterSize) SampleType lanes[Register::SIMDNumElements] = {};
+    const auto* left = block.getChannelPointer (0);
+    const auto* right = block.getChannelPointer (1);
+    const auto half = (SampleType) 0.5;
+
+    for (size_t i = 0; i < block.getNumSamples(); ++i)
+    {
+        lanes[0] = (left[i] + right[i]) * half;
+        lanes[1] = (left[i] - right[i]) * half;
+        interleaved[i] = Register::fromRawArray (lanes);
+    }
+}
+
+/** The reverse of interleaveMidSide(): left is mid + side, right is mid - side. */
+template<typename SampleType>
+void deinterleaveMidSide (const juce::dsp::SIMDRegister<SampleType>* interleaved, const juce::dsp::AudioBlock<SampleType>& block)
+{
+    using Register = juce::dsp::SIMDRegister<SampleType>;
+
+    alignas (Register::SIMDRegisterSize) SampleType lanes[Register::SIMDNumElements];
+    auto* left = block.getChannelPointer (0);
+    auto* right = block.getChannelPointer (1);
+
+    for (size_t i = 0; i < block.getNumSamples(); ++i)
+    {
+        interleaved[i].copyToRawArray (lanes);
+        left[i] = lanes[0] + lanes[1];
+        right[i] = lanes[0] - lanes[1];
+    }
+}
+
+/** How many sections each stage of a packed chain has, and which slot of the chain each one fills. */
+struct ChainLayout
+{
+    enum StageIndex
+    {
+        LowCut,
+        Bands,
+        HighCut,
+        numStages
+    };
+
+    std::array<int, numStages> lengths {};
+    std::array<int, maxChainSections> slots {};
+
+    int getNumSections() const { return lengths[LowCut] + lengths[Bands] + lengths[HighCut]; }
+
+    bool operator== (const ChainLayout& other) const { return lengths == other.lengths && slots == other.slots; }
+    bool operator!= (const ChainLayout& other) const { return ! operator== (other); }
+
+    template<typename NumericType>
+    static ChainLayout of (const ChainCoefficients<NumericType>& coefficients)
+    {
+        ChainLayout layout;
+        layout.lengths = { coefficients.lowCut.numSections,
+                           coefficients.bands.numSections,
+                           coefficients.highCut.numSections };
+
+        size_t i = 0;
+        forEachActiveSection (coefficients, [&] (int slot, const BiquadCoefficients<NumericType>&)
+        {
+            layout.slots[i++] = slot;
+        });
+
+        return layout;
+    }
+
+    /** The layout of two chains run side by side: every slot that either has active, in chain order. */
+    template<typename NumericType>
+    static ChainLayout of (const ChainCoefficients<NumericType>& first, const ChainCoefficients<NumericType>& second)
+    {
+        auto a = of (first), b = of (second);
+
+        //both lists are in chain order, so their union is a merge
+        ChainLayout layout;
+        auto end = std::set_union (a.slots.begin(), a.slots.begin() + a.getNumSections(),
+                                   b.slots.begin(), b.slots.begin() + b.getNumSections(),
+                                   layout.slots.begin());
+
+        std::for_each (layout.slots.begin(), end, [&layout] (int slot) { ++layout.lengths[getStage (slot)]; });
+        return layout;
+    }
+
+    static StageIndex getStage (int slot)
+    {
+        if (slot < getBandSlot (0))
+            return LowCut;
+
+        return slot < getHighCutSlot (0) ? Bands : HighCut;
+    }
+};
+
+/**
+ The active sections of the chain for one vector width, packed in chain
+ order (low-cut, bands, high-cut). The whole chain can run fused, as passes
+ of maxFusedSections sections across its stage boundaries, or one stage at a
+ time, or, for a single channel, across the lanes of a register.
+ */
+template<typename VectorType>
+struct PackedChain
+{
+    using ElementType = typename VectorElement<VectorType>::Type;
+    using Layout = ChainLayout;
+    using States = std::array<BiquadState<VectorType>, maxChainSections>;
+
+    static constexpr auto numStages = (size_t) ChainLayout::numStages;
+
+    /** Re-lays out states for a new layout; every section that stays active keeps its history. */
+    static void relayout (States& states, const Layout& from, const Layout& to)
+    {
+        auto previous = states;
+        auto fromSlots = from.slots.begin(), fromEnd = fromSlots + from.getNumSections();
+
+        for (int i = 0; i < to.getNumSections(); ++i)
+        {
+            //sections that were idle start again from silence rather than stale state
+            auto found = std::find (fromSlots, fromEnd, to.slots[(size_t) i]);
+            states[(size_t) i] = found != fromEnd ? previous[(size_t) (found - fromSlots)]
+                                                  : BiquadState<VectorType> { splat<VectorType> (0), splat<VectorType> (0) };
+        }
+    }
+
+    static void clear (States& states)
+    {
+        states.fill ({ splat<VectorType> (0), splat<VectorType> (0) });
+    }
+
+    void setLayout (const Layout& newLayout)
+    {
+        layout = newLayout;
+    }
+
+    void setCoefficients (const ChainCoefficients<ElementType>& coefficients)
+    {
+        jassert (ChainLayout::of (coefficients) == layout);
+
+        auto* section = sections.data();
+        forEachActiveSection (coefficients, [&section] (int, const BiquadCoefficients<ElementType>& c)
+        {
+            *section++ = broadcast (c);
+        });
+    }
+
+    /**
+     Gives lane 1 the second chain and every other lane the first. The layout
+     has to be ChainLayout::of (first, second); where one chain leaves a slot
+     out, its lanes pass their input through that section.
+     */
+    void setCoefficients (const ChainCoefficients<ElementType>& first, const ChainCoefficients<ElementType>& second)
+    {
+        static_assert (! std::is_arithmetic_v<VectorType>, "Only a register has lanes to tell apart");
+        jassert (ChainLayout::of (first, second) == layout);
+
+        //each chain's sections by slot; a default section passes its input through
+        std::array<BiquadCoefficients<ElementType>, maxChainSections> firstBySlot, secondBySlot;
+        forEachActiveSection (first, [&] (int slot, const BiquadCoefficients<ElementType>& c) { firstBySlot[(size_t) slot] = c; });
+        forEachActiveSection (second, [&] (int slot, const BiquadCoefficients<ElementType>& c) { secondBySlot[(size_t) slot] = c; });
+
+        for (int i = 0; i < layout.getNumSections(); ++i)
+        {
+            const auto& a = firstBySlot[(size_t) layout.slots[(size_t) i]];
+            const auto& b = secondBySlot[(size_t) layout.slots[(size_t) i]];
+
+            sections[(size_t) i] = { withSecondLane (a.b0, b.b0),
+                                     withSecondLane (a.b1, b.b1),
+                                     withSecondLane (a.b2, b.b2),
+                                     withSecondLane (a.a1, b.a1),
+                                     withSecondLane (a.a2, b.a2) };
+        }
+    }
+
+    void process (VectorType* samples, size_t numSamples, States& states, CascadeMode mode) const
+    {
+        if constexpr (std::is_arithmetic_v<VectorType>)
+        {
+            if (mode == CascadeMode::acrossSections)
+            {
+                processAcrossSections (samples, numSamples, sections.data(), states.data(), layout.getNumSections());
+                return;
+            }
+        }
+
+        if (mode != CascadeMode::stageByStage)
+        {
+            processCascadeInPasses (samples, numSamples, sections.data(), states.data(), layout.getNumSections());
+            return;
+        }
+
+        int firstSection = 0;
+        for (size_t stage = 0; stage < numStages; ++stage)
+        {
+            processCascadeInPasses (samples, numSamples, sections.data() + firstSection, states.data() + firstSection,
+                                    layout.lengths[stage]);
+            firstSection += layout.lengths[stage];
+        }
+    }
+
+    Layout layout;
+private:
+    std::array<BiquadSection<VectorType>, maxChainSections> sections;
+
+    static BiquadSection<VectorType> broadcast (const BiquadCoefficients<ElementType>& c)
+    {
+        return { splat<VectorType> (c.b0),
+                 splat<VectorType> (c.b1),
+                 splat<VectorType> (c.b2),
+                 splat<VectorType> (c.a1),
+                 splat<VectorType> (c.a2) };
+    }
+
+    static VectorType withSecondLane (ElementType value, ElementType secondLaneValue)
+    {
+        alignas (VectorType::SIMDRegisterSize) ElementType lanes[VectorType::SIMDNumElements];
+        std::fill (std::begin (lanes), std::end (lanes), value);
+        lanes[1] = secondLaneValue;
+        return VectorType::fromRawArray (lanes);
+    }
+};
+
+/**
+ The chain's sections in state-space form, for one channel at a time. A
+ pair can have a second chain for its second channel, as PackedChain can,
+ and the layout is the same as the cascade's, so the states carry over.
+ */
+template<typename SampleType>
+struct StateSpaceChain
+{
+    using Section = StateSpaceSection<SampleType>;
+
+    void setCoefficients (const ChainCoefficients<SampleType>& coefficients)
+    {
+        numSections = 0;
+        forEachActiveSection (coefficients, [this] (int, const BiquadCoefficients<SampleType>& c)
+        {
+            chains[0][(size_t) numSections++] = Section::design (c);
+        });
+
+        hasSecondChain = false;
+    }
+
+    /** Designs both chains over ChainLayout::of (first, second); where one leaves a slot out, its section passes its input through. */
+    void setCoefficients (const ChainCoefficients<SampleType>& first, const ChainCoefficients<SampleType>& second)
+    {
+        std::array<BiquadCoefficients<SampleType>, maxChainSections> firstBySlot, secondBySlot;
+        forEachActiveSection (first, [&] (int slot, const BiquadCoefficients<SampleType>& c) { firstBySlot[(size_t) slot] = c; });
+        forEachActiveSection (second, [&] (int slot, const BiquadCoefficients<SampleType>& c) { secondBySlot[(size_t) slot] = c; });
+
+        auto layout = ChainLayout::of (first, second);
+        numSections = layout.getNumSections();
+
+        for (int i = 0; i < numSections; ++i)
+        {
+            chains[0][(size_t) i] = Section::design (firstBySlot[(size_t) layout.slots[(size_t) i]]);
+            chains[1][(size_t) i] = Section::design (secondBySlot[(size_t) layout.slots[(size_t) i]]);
+        }
+
+        hasSecondChain = true;
+    }
+
+    /** Runs one channel through every section in turn, a cache-sized chunk at a time. */
+    void process (SampleType* samples, size_t numSamples, BiquadState<SampleType>* states, bool useSecondChain) const
+    {
+        const auto& sections = chains[useSecondChain && hasSecondChain ? 1 : 0];
+
+        for (size_t start = 0; start < numSamples; start += chunkLength)
+        {
+            auto chunkSize = juce::jmin (chunkLength, numSamples - start);
+
+            for (int k = 0; k < numSections; ++k)
+                sections[(size_t) k].process (samples + start, chunkSize, states[k]);
+        }
+    }
+private:
+    static constexpr size_t chunkLength = 1024;
+
+    std::array<std::array<Section, maxChainSections>, 2> chains;
+    int numSections = 0;
+    bool hasSecondChain = false;
+};
+
+/**
+ The chain for buses wider than a SIMDRegister: the sections flattened into
+ plain arrays, a lane per channel, and run by the widest kernel the CPU
+ supports (see getDispatchedKernels()). SIMDRegister is fixed at compile time
+ to the baseline instruction set, so on an AVX2 or AVX-512 machine this fills
+ two or four times as many channels per instruction.
+ */
+template<typename SampleType>
+struct DispatchedChain
+{
+    void prepare (size_t numChannels, size_t maximumBlockSize)
+    {
+        lanes = (size_t) getDispatchedLanes<SampleType>();
+        numGroups = (numChannels + lanes - 1) / lanes;
+
+        sections.assign ((size_t) maxChainSections * 5 * lanes, 0);
+        groupStates.assign (numGroups, std::vector<SampleType> ((size_t) maxChainSections * 2 * lanes, 0));
+        chunkSize = maximumBlockSize;
+        prepareThreads (interleaved.empty() ? 1 : interleaved.size());
+    }
+
+    /** Gives each of numThreads threads interleaving space of its own, so process() can run groups on all of them at once. */
+    void prepareThreads (size_t numThreads)
+    {
+        interleaved.resize (numThreads);
+        for (auto& scratch : interleaved)
+            scratch.resize (chunkSize * lanes);
+    }
+
+    void reset()
+    {
+        for (auto& states : groupStates)
+            std::fill (states.begin(), states.end(), (SampleType) 0);
+    }
+
+    /** As PackedChain::relayout(), for every group's states. */
+    void setLayout (const ChainLayout& newLayout)
+    {
+        auto fromSlots = layout.slots.begin(), fromEnd = fromSlots + layout.getNumSections();
+        const auto stride = 2 * lanes;
+
+        for (auto& states : groupStates)
+        {
+            auto previous = states;
+            for (int i = 0; i < newLayout.getNumSections(); ++i)
+            {
+                auto* dest = states.data() + (size_t) i * stride;
+                auto found = std::find (fromSlots, fromEnd, newLayout.slots[(size_t) i]);
+
+                if (found != fromEnd)
+                    std::copy_n (previous.data() + (size_t) (found - fromSlots) * stride, stride, dest);
+                else
+                    std::fill_n (dest, stride, (SampleType) 0);
+            }
+        }
+
+        layout = newLayout;
+    }
+
+    void setCoefficients (const ChainCoefficients<SampleType>& coefficients)
+    {
+        jassert (ChainLayout::of (coefficients) == layout);
+
+        int i = 0;
+        forEachActiveSection (coefficients, [this, &i] (int, const BiquadCoefficients<SampleType>& c)
+        {
+            setSection (i++, c, c);
+        });
+    }
+
+    /** As PackedChain::setCoefficients (first, second): lane 1 of each group runs the second chain. */
+    void setCoefficients (const ChainCoefficients<SampleType>& first, const ChainCoefficients<SampleType>& second)
+    {
+        jassert (ChainLayout::of (first, second) == layout);
+
+        std::array<BiquadCoefficients<SampleType>, maxChainSections> firstBySlot, secondBySlot;
+        forEachActiveSection (first, [&] (int slot, const BiquadCoefficients<SampleType>& c) { firstBySlot[(size_t) slot] = c; });
+        forEachActiveSection (second, [&] (int slot, const BiquadCoefficients<SampleType>& c) { secondBySlot[(size_t) slot] = c; });
+
+        for (int i = 0; i < layout.getNumSections(); ++i)
+            setSection (i, firstBySlot[(size_t) layout.slots[(size_t) i]], secondBySlot[(size_t) layout.slots[(size_t) i]]);
+    }
+
+    /** Runs the groups one after another, or, given a pool, shares them out across it. */
+    void process (const juce::dsp::AudioBlock<SampleType>& block, WorkStealingPool* pool = nullptr)
+    {
+        auto numBlockGroups = (block.getNumChannels() + lanes - 1) / lanes;
+
+        if (pool != nullptr)
+        {
+            jassert ((size_t) pool->getNumThreads() <= interleaved.size());
+            pool->run ((int) numBlockGroups, [&] (int group, int thread)
+            {
+                processGroup (block, (size_t) group, interleaved[(size_t) thread]);
+            });
+            return;
+        }
+
+        for (size_t group = 0; group < numBlockGroups; ++group)
+            processGroup (block, group, interleaved.front());
+    }
+
+    size_t getChannelsPerGroup() const { return lanes; }
+
+    ChainLayout layout;
+private:
+    size_t lanes = 1, numGroups = 0, chunkSize = 0;
+
+    //per section: b0, b1, b2, a1, a2, each a run of one value per lane
+    std::vector<SampleType> sections;
+    //per group, per section: s1, s2, laid out the same way
+    std::vector<std::vector<SampleType>> groupStates;
+    //one per thread that can run a group
+    std::vector<std::vector<SampleType>> interleaved;
+
+    void setSection (int index, const BiquadCoefficients<SampleType>& c, const BiquadCoefficients<SampleType>& lane1)
+    {
+        auto* dest = sections.data() + (size_t) index * 5 * lanes;
+        const SampleType values[] { c.b0, c.b1, c.b2, c.a1, c.a2 };
+        const SampleType lane1Values[] { lane1.b0, lane1.b1, lane1.b2, lane1.a1, lane1.a2 };
+
+        for (size_t k = 0; k < 5; ++k)
+        {
+            std::fill_n (dest + k * lanes, lanes, values[k]);
+            if (lanes > 1)
+                dest[k * lanes + 1] = lane1Values[k];
+        }
+    }
+
+    void processGroup (const juce::dsp::AudioBlock<SampleType>& block, size_t group, std::vector<SampleType>& scratch)
+    {
+        auto firstChannel = group * lanes;
+        auto numGroupChannels = juce::jmin (lanes, block.getNumChannels() - firstChannel);
+
+        for (size_t start = 0; start < block.getNumSamples(); start += chunkSize)
+        {
+            auto subBlock = block.getSubBlock (start, juce::jmin (chunkSize, block.getNumSamples() - start));
+            processChunk (subBlock, group, firstChannel, numGroupChannels, scratch.data());
+        }
+    }
+
+    void processChunk (const juce::dsp::AudioBlock<SampleType>& block, size_t group, size_t firstChannel, size_t numGroupChannels,
+                       SampleType* scratch)
+    {
+        const auto numSamples = block.getNumSamples();
+
+        for (size_t ch = 0; ch < lanes; ++ch)
+        {
+            auto* dest = scratch + ch;
+
+            //lanes with no channel of their own run on silence
+            if (ch >= numGroupChannels)
+            {
+                for (size_t i = 0; i < numSamples; ++i)
+                    dest[i * lanes] = 0;
+
+                continue;
+            }
+
+            const auto* source = block.getChannelPointer (firstChannel + ch);
+            for (size_t i = 0; i < numSamples; ++i)
+                dest[i * lanes] = source[i];
+        }
+
+        runDispatchedCascade (scratch, numSamples, sections.data(), groupStates[group].data(), layout.getNumSections());
+
+        for (size_t ch = 0; ch < numGroupChannels; ++ch)
+        {
+            const auto* source = scratch + ch;
+            auto* dest = block.getChannelPointer (firstChannel + ch);
+
+            for (size_t i = 0; i < numSamples; ++i)
+                dest[i] = source[i * lanes];
+        }
+    }
+};
+
+/**
+ Runs the low-cut, band and high-cut stages over any number of channels from
+ one shared set of coefficients.
+
+ Wider buses are packed into groups of SIMDRegister<SampleType>::size()
+ channels, one channel per lane, so a stereo pair or a group of surround or
+ ambisonic channels is filtered by a single instruction stream. A mono bus
+ leaves no channels to fill the lanes with, so it is filtered in place, with
+ either scalar kernels or the sections spread across the lanes instead.
+
+ A mono bus can instead run the chain in parallel form, where the sections
+ fill the lanes themselves, for any design that expands accurately into one.
+
+ A stereo pair can also run as mid and side, with a chain of its own for
+ each. The pair is encoded as it is packed into the lanes and decoded as it
+ is unpacked, so the matrix adds no pass over the buffer.
+
+ Which kernels are fastest depends on the block size, so prepare() times
+ them and automatic mode picks per block. Those kernels are bit-identical to
+ one another, so the choice never shows in the output. Offline renders run a
+ state-space kernel that takes several samples per step instead; its output
+ differs in the last bits, so it is chosen by setRenderingOffline() alone and
+ never by a timing, and two renders of a session always match. A bus with
+ more channels than a SIMDRegister has lanes goes to a DispatchedChain
+ instead, whenever the CPU has wider registers than the ones SIMDRegister
+ was built for.
+
+ Given a WorkStealingPool, multithreaded offline renders run the groups, or
+ with the state-space kernel the single channels, on the pool's threads at
+ once.
+ */
+template<typename SampleType>
+class MultiChannelBiquadCascade
+{
+public:
+    using Register = juce::dsp::SIMDRegister<SampleType>;
+    static constexpr size_t numLanes = Register::SIMDNumElements;
+
+    void prepare (const juce::dsp::ProcessSpec& spec)
+    {
+        numChannels = spec.numChannels;
+
+        auto maximumBlockSize = (size_t) juce::jmax (spec.maximumBlockSize, (juce::uint32) 1);
+
+        //the dispatched kernel has one pass, so there is nothing to time
+        runDispatched = ! isMono() && numChannels > numLanes && (size_t) getDispatchedLanes<SampleType>() > numLanes;
+        chunkLength = maximumBlockSize;
+
+        if (runDispatched)
+        {
+            dispatchedChain.prepare (numChannels, maximumBlockSize);
+            numGroups = 0;
+            interleaved.clear();
+            groupStates.clear();
+            channelStates.clear();
+            prepareThreads();
+            reset();
+
+            //nothing was timed, so an earlier layout's speedups must not be reported
+            stateSpaceSpeedups.fill (0);
+            return;
+        }
+
+        numGroups = isMono() ? 0 : (numChannels + numLanes - 1) / numLanes;
+        parallelChain.prepare (isMono() ? maximumBlockSize : 0);
+        groupStates.resize (numGroups);
+        channelStates.resize (isMono() ? 0 : numChannels);
+        prepareThreads();
+
+        if (isMono())
+        {
+            std::vector<SampleType> scratch (maximumBlockSize);
+            calibrate (scratch);
+        }
+        else
+        {
+            calibrate (interleaved.front());
+        }
+
+        calibrateStateSpace();
+        reset();
+    }
+
+    void reset()
+    {
+        PackedChain<SampleType>::clear (monoStates);
+
+        for (auto& states : groupStates)
+            PackedChain<Register>::clear (states);
+
+        dispatchedChain.reset();
+        parallelChain.reset();
+    }
+
+    void setMode (CascadeMode newMode) { mode = newMode; }
+
+    /** Returns the kernels the timings taken in prepare() favoured at this block size. */
+    CascadeMode getFastestModeFor (size_t numSamples) const { return fastestModes[(size_t) getCalibrationIndex (numSamples)]; }
+
+    /**
+     Takes a new design. parallel is the same design from getParallelForm(), or
+     nullptr where it did not expand; a mono bus runs it if setParallelForm() allows.
+     */
+    void setCoefficients (const ChainCoefficients<SampleType>& coefficients,
+                          const ParallelCoefficients<SampleType>* parallel = nullptr)
+    {
+        setLayout (ChainLayout::of (coefficients));
+        stateSpaceChain.setCoefficients (coefficients);
+
+        if (isMono())
+        {
+            monoChain.setCoefficients (coefficients);
+
+            //the cascade is kept up to date too, for when a later design does not expand
+            auto shouldRunParallel = parallelForm && parallel != nullptr;
+            if (shouldRunParallel)
+                parallelChain.setCoefficients (*parallel);
+
+            if (shouldRunParallel != runningParallel)
+            {
+                //the two realisations' states mean nothing to one another
+                if (shouldRunParallel)
+                    parallelChain.reset();
+                else
+                    PackedChain<SampleType>::clear (monoStates);
+
+                runningParallel = shouldRunParallel;
+            }
+        }
+        else if (runDispatched)
+            dispatchedChain.setCoefficients (coefficients);
+        else
+            wideChain.setCoefficients (coefficients);
+    }
+
+    /** Runs the second channel, or the side, through its own chain; every other channel runs the first. */
+    void setCoefficients (const ChainCoefficients<SampleType>& first, const ChainCoefficients<SampleType>& second)
+    {
+        if (isMono())
+        {
+            setCoefficients (first);
+            return;
+        }
+
+        setLayout (ChainLayout::of (first, second));
+        stateSpaceChain.setCoefficients (first, second);
+
+        if (runDispatched)
+            dispatchedChain.setCoefficients (first, second);
+        else
+            wideChain.setCoefficients (first, second);
+    }
+
+    /** Encodes a stereo bus to mid and side before the chain and decodes it after. Other buses are left as they are. */
+    void setMidSide (bool shouldRunMidSide)
+    {
+        if (shouldRunMidSide == midSide)
+            return;
+
+        //the states hold mid and side, or left and right, and mean nothing as the other
+        midSide = shouldRunMidSide;
+        reset();
+    }
+
+    bool isRunningMidSide() const { return midSide && numChannels == 2; }
+
+    /**
+     Lets a mono bus run the chain in parallel form, from the next
+     setCoefficients() given an expansion on. A design that coincident poles or
+     cancellation keep from expanding accurately runs as a cascade until one
+     that does comes along.
+     */
+    void setParallelForm (bool shouldUseParallelForm)
+    {
+        parallelForm = shouldUseParallelForm;
+
+        if (! parallelForm && runningParallel)
+        {
+            PackedChain<SampleType>::clear (monoStates);
+            runningParallel = false;
+        }
+    }
+
+    bool isRunningParallelForm() const { return runningParallel; }
+
+    /**
+     Makes automatic mode run the state-space kernel while set. It allocates
+     nothing, so it can follow AudioProcessor::isNonRealtime() every block.
+     */
+    void setRenderingOffline (bool isOffline) { renderingOffline = isOffline; }
+
+    /**
+     Runs on the pool given to setWorkerPool() while set, which only offline
+     renders should be; the kernels chosen stay the same. It allocates
+     nothing, so it can change every block.
+     */
+    void setMultithreaded (bool shouldUseWorkerPool) { multithreaded = shouldUseWorkerPool; }
+
+    /**
+     Returns how many times faster than the fastest cascade kernel prepare()
+     timed the state-space kernel at this block size, or 0 if it measured none.
+     It is only reported; it never chooses a kernel.
+     */
+    double getStateSpaceSpeedup (size_t numSamples) const { return stateSpaceSpeedups[(size_t) getCalibrationIndex (numSamples)]; }
+
+    /**
+     Lets offline renders share the channel groups out across the pool's
+     threads, or keeps them all on the caller for nullptr. It allocates space
+     for each thread, and prepare() keeps it sized for the pool, so call it
+     once, off the audio thread.
+     */
+    void setWorkerPool (WorkStealingPool* poolToUse)
+    {
+        workerPool = poolToUse;
+        prepareThreads();
+    }
+
+    /** Returns how many channels share each pass of the kernel. */
+    size_t getChannelsPerGroup() const { return runDispatched ? dispatchedChain.getChannelsPerGroup() : numLanes; }
+
+    void process (const juce::dsp::AudioBlock<SampleType>& block)
+    {
+        jassert (block.getNumChannels() <= numChannels);
+
+        auto numSamples = block.getNumSamples();
+
+        if (isMono() && runningParallel)
+        {
+            parallelChain.process (block.getChannelPointer (0), numSamples);
+            return;
+        }
+
+        //mid/side needs the pair packed together to encode it, and the dispatched chain keeps states of its own
+        if (getModeFor (numSamples) == CascadeMode::stateSpace && ! isRunningMidSide() && ! runDispatched)
+        {
+            processStateSpace (block);
+            return;
+        }
+
+        if (isMono())
+        {
+            //no interleaving needed: filter the channel where it is
+            monoChain.process (block.getChannelPointer (0), numSamples, monoStates, getModeFor (numSamples));
+            return;
+        }
+
+        if (runDispatched)
+        {
+            dispatchedChain.process (block, getActivePool());
+            return;
+        }
+
+        //the groups share nothing but the coefficients, so each can run its whole block on its own thread
+        forEachTask ((block.getNumChannels() + numLanes - 1) / numLanes, [&] (size_t group, size_t thread)
+        {
+            auto& scratch = interleaved[thread];
+
+            for (size_t start = 0; start < numSamples; start += scratch.size())
+                processGroup (block.getSubBlock (start, juce::jmin (scratch.size(), numSamples - start)), group, scratch.data());
+        });
+    }
+private:
+    PackedChain<SampleType> monoChain;
+    PackedChain<Register> wideChain;
+
+    typename PackedChain<SampleType>::States monoStates;
+    std::vector<typename PackedChain<Register>::States> groupStates;
+    //the state-space kernel's states, taken out of the groups' lanes a channel at a time
+    std::vector<typename PackedChain<SampleType>::States> channelStates;
+    //one per thread that can run a group
+    std::vector<std::vector<Register>> interleaved;
+    DispatchedChain<SampleType> dispatchedChain;
+    ParallelBiquadChain<SampleType> parallelChain;
+    StateSpaceChain<SampleType> stateSpaceChain;
+
+    size_t numChannels = 0, numGroups = 0, chunkLength = 0;
+    WorkStealingPool* workerPool = nullptr;
+    CascadeMode mode = CascadeMode::automatic;
+    bool midSide = false, runDispatched = false, parallelForm = false, runningParallel = false, renderingOffline = false, multithreaded = false;
+
+    //one entry per power of two block size, from 32 samples up to 2048
+    static constexpr int numCalibrationSizes = 7;
+    std::array<CascadeMode, numCalibrationSizes> fastestModes {};
+
+    //the fastest cascade kernel's time at each size, which the state-space kernel is timed against
+    std::array<juce::int64, numCalibrationSizes> fastestTimes {};
+    std::array<double, numCalibrationSizes> stateSpaceSpeedups {};
+
+    bool isMono() const { return numChannels == 1; }
+
+    void prepareThreads()
+    {
+        auto numThreads = workerPool != nullptr ? (size_t) workerPool->getNumThreads() : 1;
+
+        if (runDispatched)
+        {
+            dispatchedChain.prepareThreads (numThreads);
+            return;
+        }
+
+        interleaved.resize (isMono() ? 0 : numThreads);
+        for (auto& scratch : interleaved)
+            scratch.resize (chunkLength);
+    }
+
+    //run() waits for the pool's threads, which only an offline render can afford
+    WorkStealingPool* getActivePool() const { return multithreaded ? workerPool : nullptr; }
+
+    /** Calls task (index, thread) for every index below numTasks, across the pool when there is an active one. */
+    template<typename Task>
+    void forEachTask (size_t numTasks, Task&& task)
+    {
+        if (auto* pool = getActivePool())
+        {
+            pool->run ((int) numTasks, [&task] (int index, int thread) { task ((size_t) index, (size_t) thread); });
+            return;
+        }
+
+        for (size_t i = 0; i < numTasks; ++i)
+            task (i, 0);
+    }
+
+    static int getCalibrationIndex (size_t numSamples)
+    {
+        int index = 0;
+        while (index < numCalibrationSizes - 1 && ((size_t) 32 << index) < numSamples)
+            ++index;
+
+        return index;
+    }
+
+    void setLayout (const ChainLayout& layout)
+    {
+        //the kernels only change with the slopes and the active bands, never per block
+        if (layout == monoChain.layout)
+            return;
+
+        PackedChain<SampleType>::relayout (monoStates, monoChain.layout, layout);
+
+        for (auto& states : groupStates)
+            PackedChain<Register>::relayout (states, monoChain.layout, layout);
+
+        dispatchedChain.setLayout (layout);
+        monoChain.setLayout (layout);
+        wideChain.setLayout (layout);
+    }
+
+    CascadeMode getModeFor (size_t numSamples) const
+    {
+        if (mode != CascadeMode::automatic)
+            return mode;
+
+        //the cascade kernels all give the same output, so only the offline switch changes what is heard
+        if (renderingOffline)
+            return CascadeMode::stateSpace;
+
+        return getFastestModeFor (numSamples);
+    }
+
+    void processGroup (const juce::dsp::AudioBlock<SampleType>& block, size_t group, Register* scratch)
+    {
+        auto firstChannel = group * numLanes;
+        auto numGroupChannels = juce::jmin (numLanes, block.getNumChannels() - firstChannel);
+        auto numSamples = block.getNumSamples();
+
+        if (isRunningMidSide())
+        {
+            interleaveMidSide (block, scratch);
+            wideChain.process (scratch, numSamples, groupStates[group], getModeFor (numSamples));
+            deinterleaveMidSide (scratch, block);
+            return;
+        }
+
+        interleaveChannels (block, firstChannel, numGroupChannels, scratch);
+        wideChain.process (scratch, numSamples, groupStates[group], getModeFor (numSamples));
+        deinterleaveChannels (scratch, block, firstChannel, numGroupChannels);
+    }
+
+    void processStateSpace (const juce::dsp::AudioBlock<SampleType>& block)
+    {
+        auto numSamples = block.getNumSamples();
+
+        if (isMono())
+        {
+            stateSpaceChain.process (block.getChannelPointer (0), numSamples, monoStates.data(), false);
+            return;
+        }
+
+        //the kernel runs a channel at a time, in place, so each channel's states come out of its lane and go back after
+        auto numBlockChannels = block.getNumChannels();
+        auto numSections = (size_t) monoChain.layout.getNumSections();
+
+        for (size_t ch = 0; ch < numBlockChannels; ++ch)
+        {
+            const auto& laneStates = groupStates[ch / numLanes];
+            auto lane = ch % numLanes;
+
+            for (size_t k = 0; k < numSections; ++k)
+                channelStates[ch][k] = { laneStates[k].s1.get (lane), laneStates[k].s2.get (lane) };
+        }
+
+        //with the states apart, even the two channels of a pair can run on threads of their own
+        forEachTask (numBlockChannels, [&] (size_t ch, size_t)
+        {
+            stateSpaceChain.process (block.getChannelPointer (ch), numSamples, channelStates[ch].data(), ch % numLanes == 1);
+        });
+
+        for (size_t ch = 0; ch < numBlockChannels; ++ch)
+        {
+            auto& laneStates = groupStates[ch / numLanes];
+            auto lane = ch % numLanes;
+
+            for (size_t k = 0; k < numSections; ++k)
+            {
+                laneStates[k].s1.set (lane, channelStates[ch][k].s1);
+                laneStates[k].s2.set (lane, channelStates[ch][k].s2);
+            }
+        }
+    }
+
+    /** Both cuts at their steepest, and a typical handful of bands. */
+    static ChainCoefficients<SampleType> getCalibrationCoefficients()
+    {
+        static constexpr int calibrationBands = 8;
+
+        ChainCoefficients<SampleType> coefficients;
+        coefficients.lowCut.numSections = maxCutFilterSections;
+        coefficients.bands.numSections = calibrationBands;
+        coefficients.highCut.numSections = maxCutFilterSections;
+
+        const BiquadCoefficients<SampleType> section { (SampleType) 0.5, (SampleType) 0.1, (SampleType) 0.05,
+                                                       (SampleType) -0.2, (SampleType) 0.1 };
+        coefficients.lowCut.sections.fill (section);
+        coefficients.bands.sections.fill (section);
+        coefficients.highCut.sections.fill (section);
+
+        for (int band = 0; band < calibrationBands; ++band)
+            coefficients.bands.bandIndices[(size_t) band] = band;
+
+        return coefficients;
+    }
+
+    /**
+     Times the state-space kernel at each size calibrate() measured, for the
+     whole bus: every channel one after another, against the cascade's groups
+     of channels.
+     */
+    void calibrateStateSpace()
+    {
+        stateSpaceSpeedups.fill (0);
+
+        StateSpaceChain<SampleType> chain;
+        chain.setCoefficients (getCalibrationCoefficients());
+
+        typename PackedChain<SampleType>::States states;
+        PackedChain<SampleType>::clear (states);
+
+        std::vector<SampleType> scratch;
+
+        for (size_t index = 0; index < numCalibrationSizes; ++index)
+        {
+            if (fastestTimes[index] <= 0)
+                continue;
+
+            scratch.resize ((size_t) 32 << index);
+            auto best = std::numeric_limits<juce::int64>::max();
+
+            for (int attempt = 0; attempt < 3; ++attempt)
+            {
+                for (size_t i = 0; i < scratch.size(); ++i)
+                    scratch[i] = (SampleType) ((i & 1) != 0 ? 0.25 : -0.25);
+
+                auto start = juce::Time::getHighResolutionTicks();
+                for (int pass = 0; pass < 4; ++pass)
+                    chain.process (scratch.data(), scratch.size(), states.data(), false);
+
+                best = juce::jmin (best, juce::Time::getHighResolutionTicks() - start);
+            }
+
+            auto cascadeTime = (double) fastestTimes[index] * (double) juce::jmax (numGroups, (size_t) 1);
+            auto stateSpaceTime = (double) juce::jmax (best, (juce::int64) 1) * (double) numChannels;
+            stateSpaceSpeedups[index] = cascadeTime / stateSpaceTime;
+        }
+    }
+
+    /**
+     Times each kind of kernel on a chain of calibrationSections sections for
+     every calibration size that fits in the scratch buffer, keeping the best
+     of a few runs of each. Larger sizes reuse the largest measured result.
+     */
+    template<typename VectorType>
+    void calibrate (std::vector<VectorType>& scratch)
+    {
+        auto coefficients = getCalibrationCoefficients();
+
+        PackedChain<VectorType> chain;
+        chain.setLayout (ChainLayout::of (coefficients));
+        chain.setCoefficients (coefficients);
+
+        typename PackedChain<VectorType>::States states;
+        PackedChain<VectorType>::clear (states);
+
+        //spreading the sections across the lanes only makes sense with one channel per register
+        std::vector<CascadeMode> candidates { CascadeMode::fused, CascadeMode::stageByStage };
+        if (std::is_arithmetic_v<VectorType> && numLanes > 1)
+            candidates.push_back (CascadeMode::acrossSections);
+
+        auto timeRuns = [&] (CascadeMode candidate, size_t numSamples)
+        {
+            auto best = std::numeric_limits<juce::int64>::max();
+            for (int attempt = 0; attempt < 3; ++attempt)
+            {
+                for (size_t i = 0; i < numSamples; ++i)
+                    scratch[i] = splat<VectorType> ((SampleType) ((i & 1) != 0 ? 0.25 : -0.25));
+
+                auto start = juce::Time::getHighResolutionTicks();
+                for (int pass = 0; pass < 4; ++pass)
+                    chain.process (scratch.data(), numSamples, states, candidate);
+
+                best = juce::jmin (best, juce::Time::getHighResolutionTicks() - start);
+            }
+
+            return best;
+        };
+
+        fastestTimes.fill (0);
+
+        for (size_t index = 0; index < numCalibrationSizes; ++index)
+        {
+            auto numSamples = (size_t) 32 << index;
+            if (numSamples > scratch.size())
+            {
+                fastestModes[index] = index > 0 ? fastestModes[index - 1] : CascadeMode::fused;
+                continue;
+            }
+
+            auto bestTime = std::numeric_limits<juce::int64>::max();
+            for (auto candidate : candidates)
+            {
+                auto time = timeRuns (candidate, numSamples);
+                if (time < bestTime)
+                {
+                    bestTime = time;
+                    fastestModes[index] = candidate;
+                }
+            }
+
+            fastestTimes[index] = bestTime;
+        }
+    }
+};
@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    Picks the widest build of the kernels the CPU can run, once, when the
+    plugin first needs them.
+
+  ==============================================================================
+*/
+
+#include "CpuDispatch.h"
+#include "KernelsImpl.h"
+
+namespace
+{
+    //this unit is built for the baseline instruction set, so its build of the kernels runs anywhere
+    const KernelTable genericKernels = makeKernelTable<ScalarOps<float>, ScalarOps<double>> ("Generic");
+
+    const KernelTable& chooseKernels()
+    {
+        if (auto* kernels = getAvx512Kernels(); kernels != nullptr && juce::SystemStats::hasAVX512F())
+            return *kernels;
+
+        if (auto* kernels = getAvx2Kernels(); kernels != nullptr && juce::SystemStats::hasAVX2())
+            return *kernels;
+
+        if (auto* kernels = getSse2Kernels(); kernels != nullptr && juce::SystemStats::hasSSE2())
+            return *kernels;
+
+        return genericKernels;
+    }
+}
+
+const KernelTable* getGenericKernels()  { return &genericKernels; }
+
+const KernelTable& getDispatchedKernels()
+{
+    static const KernelTable& kernels = chooseKernels();
+    return kernels;
+}
+
+juce::String getKernelDiagnostics()
+{
+    const auto& kernels = getDispatchedKernels();
+
+    return juce::String (kernels.name)
+         + " kernels (" + juce::String (kernels.floatLanes) + " float / "
+         + juce::String (kernels.doubleLanes) + " double lanes) on "
+         + juce::SystemStats::getCpuModel();
+}
+
+void getChainMagnitudes (const ChainCoefficients<double>& chain, const double* frequencies, int numPoints,
+                         double sampleRate, double* magnitudes)
+{
+    std::vector<double> sections;
+    sections.reserve ((size_t) maxChainSections * 5);
+
+    forEachActiveSection (chain, [&sections] (int, const BiquadCoefficients<double>& c)
+    {
+        sections.insert (sections.end(), { c.b0, c.b1, c.b2, c.a1, c.a2 });
+    });
+
+    //the kernel wants the angle's sine and cosine and those of twice it, one array each
+    std::vector<double> trig ((size_t) numPoints * 4);
+    auto* cos1 = trig.data();
+    auto* sin1 = cos1 + numPoints;
+    auto* cos2 = sin1 + numPoints;
+    auto* sin2 = cos2 + numPoints;
+
+    for (int i = 0; i < numPoints; ++i)
+    {
+        auto w = juce::MathConstants<double>::twoPi * frequencies[i] / sampleRate;
+        cos1[i] = std::cos (w);
+        sin1[i] = std::sin (w);
+        cos2[i] = std::cos (2 * w);
+        sin2[i] = std::sin (2 * w);
+    }
+
+    getDispatchedKernels().chainMagnitudes (cos1, sin1, cos2, sin2, numPoints,
+                                            sections.data(), (int) sections.size() / 5, magnitudes);
+}
@@ -0,0 +1,50 @@
+/*
+  ==============================================================================
+
+    Picks the widest build of the kernels the CPU can run, once, when the
+    plugin first needs them.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "KernelTable.h"
+#include "FilterCoefficients.h"
+
+/**
+ Returns the kernels for the widest instruction set both built in and
+ supported by this CPU: AVX-512, then AVX2, then SSE2, then plain scalar
+ code. The choice is made on the first call and never changes after it.
+ */
+const KernelTable& getDispatchedKernels();
+
+/** Describes the kernels in use and the CPU they were picked for, for display. */
+juce::String getKernelDiagnostics();
+
+/** How many channels the dispatched cascade kernel runs at once for this sample type. */
+template<typename SampleType>
+int getDispatchedLanes()
+{
+    const auto& kernels = getDispatchedKernels();
+    return std::is_same_v<SampleType, float> ? kernels.floatLanes : kernels.doubleLanes;
+}
+
+/** Calls the dispatched cascade kernel for this sample type. */
+inline void runDispatchedCascade (float* samples, size_t numSamples, const float* sections, float* states, int numSections)
+{
+    getDispatchedKernels().cascadeFloat (samples, numSamples, sections, states, numSections);
+}
+
+inline void runDispatchedCascade (double* samples, size_t numSamples, const double* sections, double* states, int numSections)
+{
+    getDispatchedKernels().cascadeDouble (samples, numSamples, sections, states, numSections);
+}
+
+/**
+ Writes the chain's gain at each of numPoints frequencies, as
+ getMagnitudeForFrequency() would, several frequencies per instruction.
+ */
+void getChainMagnitudes (const ChainCoefficients<double>& chain, const double* frequencies, int numPoints,
+                         double sampleRate, double* magnitudes);
@@ -0,0 +1,440 @@
+/*
+  ==============================================================================
+
+    Plain, preallocated coefficient storage for the filter chain, and the
+    lock-free exchange used to hand it from the designer to the audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ A normalised biquad, laid out the same way as juce::dsp::IIR::Coefficients
+ stores a second order section: b0, b1, b2, a1, a2.
+ */
+template<typename NumericType>
+struct BiquadCoefficients
+{
+    NumericType b0 { 1 }, b1 { 0 }, b2 { 0 }, a1 { 0 }, a2 { 0 };
+};
+
+//the steepest cut, 96 dB/oct; a cut of order n runs n / 2 biquads
+static constexpr int maxCutFilterOrder = 16;
+static constexpr int maxCutFilterSections = maxCutFilterOrder / 2;
+
+enum CutType
+{
+    Cut_Butterworth,
+    Cut_LinkwitzRiley
+};
+
+//the most parametric bands a chain can hold; each is one biquad
+static constexpr int maxBands = 24;
+
+enum BandType
+{
+    Band_Bell,
+    Band_LowShelf,
+    Band_HighShelf,
+    Band_Notch,
+    Band_Tilt
+};
+
+template<typename NumericType>
+struct CutCoefficients
+{
+    std::array<BiquadCoefficients<NumericType>, maxCutFilterSections> sections;
+    int numSections = 0;
+};
+
+/** The active parametric bands, packed in band order, so switched-off bands take no space and no time. */
+template<typename NumericType>
+struct BandCoefficients
+{
+    std::array<BiquadCoefficients<NumericType>, maxBands> sections;
+
+    //which band each packed section belongs to
+    std::array<int, maxBands> bandIndices {};
+    int numSections = 0;
+};
+
+template<typename NumericType>
+struct ChainCoefficients
+{
+    CutCoefficients<NumericType> lowCut;
+    BandCoefficients<NumericType> bands;
+    CutCoefficients<NumericType> highCut;
+};
+
+static constexpr int maxChainSections = 2 * maxCutFilterSections + maxBands;
+
+/**
+ Returns the section's place in the chain: the low-cut's sections come first,
+ then a slot per band, then the high-cut's. A section keeps its place while
+ other bands switch on and off, so filter state can follow it.
+ */
+inline int getLowCutSlot (int section)  { return section; }
+inline int getBandSlot (int band)       { return maxCutFilterSections + band; }
+inline int getHighCutSlot (int section) { return maxCutFilterSections + maxBands + section; }
+
+/** Calls function (slot, coefficients) for each of the chain's active sections, in order. */
+template<typename NumericType, typename Function>
+void forEachActiveSection (const ChainCoefficients<NumericType>& chain, Function&& function)
+{
+    for (int i = 0; i < chain.lowCut.numSections; ++i)
+        function (getLowCutSlot (i), chain.lowCut.sections[(size_t) i]);
+
+    for (int i = 0; i < chain.bands.numSections; ++i)
+        function (getBandSlot (chain.bands.bandIndices[(size_t) i]), chain.bands.sections[(size_t) i]);
+
+    for (int i = 0; i < chain.highCut.numSections; ++i)
+        function (getHighCutSlot (i), chain.highCut.sections[(size_t) i]);
+}
+
+/** Returns the chain with only its low-cut sections left active. */
+template<typename NumericType>
+ChainCoefficients<NumericType> getLowCutOnly (ChainCoefficients<NumericType> chain)
+{
+    chain.bands.numSections = 0;
+    chain.highCut.numSections = 0;
+    return chain;
+}
+
+/** Returns the chain with its low-cut sections removed. */
+template<typename NumericType>
+ChainCoefficients<NumericType> getWithoutLowCut (ChainCoefficients<NumericType> chain)
+{
+    chain.lowCut.numSections = 0;
+    return chain;
+}
+
+/** Returns the magnitude of the section's largest pole. */
+template<typename NumericType>
+NumericType getPoleRadius (const BiquadCoefficients<NumericType>& c)
+{
+    //poles are the roots of z^2 + a1 z + a2
+    auto discriminant = c.a1 * c.a1 - 4 * c.a2;
+    if (discriminant < 0)
+        return std::sqrt (c.a2);
+
+    auto root = std::sqrt (discriminant);
+    return juce::jmax (std::abs (-c.a1 + root), std::abs (-c.a1 - root)) / 2;
+}
+
+/** Returns the section's gain at the given frequency, as IIR::Coefficients::getMagnitudeForFrequency does. */
+template<typename NumericType>
+double getMagnitudeForFrequency (const BiquadCoefficients<NumericType>& c, double frequency, double sampleRate)
+{
+    const auto z = std::polar (1.0, -juce::MathConstants<double>::twoPi * frequency / sampleRate);
+
+    auto numerator = (double) c.b0 + z * ((double) c.b1 + z * (double) c.b2);
+    auto denominator = 1.0 + z * ((double) c.a1 + z * (double) c.a2);
+
+    return std::abs (numerator / denominator);
+}
+
+/** Returns the gain of the chain's active sections at the given frequency. */
+template<typename NumericType>
+double getMagnitudeForFrequency (const ChainCoefficients<NumericType>& chain, double frequency, double sampleRate)
+{
+    auto magnitude = 1.0;
+
+    forEachActiveSection (chain, [&] (int, const BiquadCoefficients<NumericType>& section)
+    {
+        magnitude *= getMagnitudeForFrequency (section, frequency, sampleRate);
+    });
+
+    return magnitude;
+}
+
+/**
+ Returns roughly how many samples the chain's active sections take to ring
+ down below the given gain, judged from the pole closest to the unit circle.
+ */
+template<typename NumericType>
+int getDecayLengthInSamples (const ChainCoefficients<NumericType>& chain, double threshold, int maxLength)
+{
+    double radius = 0;
+    int numActiveSections = 0;
+
+    forEachActiveSection (chain, [&] (int, const BiquadCoefficients<NumericType>& section)
+    {
+        radius = juce::jmax (radius, (double) getPoleRadius (section));
+        ++numActiveSections;
+    });
+
+    //with no feedback, only the zeros' delay lines have to flush
+    if (radius <= 0)
+        return 2 * numActiveSections;
+
+    if (radius >= 1)
+        return maxLength;
+
+    return (int) juce::jmin ((double) maxLength, std::ceil (std::log (threshold) / std::log (radius)));
+}
+
+template<typename NumericType>
+void copyCoefficients (BiquadCoefficients<NumericType>& dest,
+                       const juce::dsp::IIR::Coefficients<NumericType>& source)
+{
+    jassert (source.getFilterOrder() == 2);
+    auto* c = source.getRawCoefficients();
+    dest = { c[0], c[1], c[2], c[3], c[4] };
+}
+
+//the designers below match juce::dsp::IIR::Coefficients and FilterDesign formula for
+//formula, but return plain values instead of allocating, so the audio thread can call them
+
+/** Divides a biquad through by a0, as IIR::Coefficients does. */
+template<typename NumericType>
+BiquadCoefficients<NumericType> makeNormalisedBiquad (NumericType b0, NumericType b1, NumericType b2,
+                                                      NumericType a0, NumericType a1, NumericType a2)
+{
+    auto a0Inverse = 1 / a0;
+    return { b0 * a0Inverse, b1 * a0Inverse, b2 * a0Inverse, a1 * a0Inverse, a2 * a0Inverse };
+}
+
+/** As IIR::Coefficients::makePeakFilter. */
+template<typename NumericType>
+BiquadCoefficients<NumericType> makePeakBiquad (double sampleRate, NumericType frequency,
+                                                NumericType Q, NumericType gainFactor)
+{
+    const auto A = juce::jmax (static_cast<NumericType> (0.0), std::sqrt (gainFactor));
+    const auto omega = (2 * juce::MathConstants<NumericType>::pi * juce::jmax (frequency, static_cast<NumericType> (2.0)))
+                     / static_cast<NumericType> (sampleRate);
+    const auto alpha = std::sin (omega) / (Q * 2);
+    const auto c2 = -2 * std::cos (omega);
+    const auto alphaTimesA = alpha * A;
+    const auto alphaOverA = alpha / A;
+
+    return makeNormalisedBiquad<NumericType> (1 + alphaTimesA, c2, 1 - alphaTimesA,
+                                              1 + alphaOverA, c2, 1 - alphaOverA);
+}
+
+/** As IIR::Coefficients::makeLowShelf. */
+template<typename NumericType>
+BiquadCoefficients<NumericType> makeLowShelfBiquad (double sampleRate, NumericType cutOffFrequency,
+                                                    NumericType Q, NumericType gainFactor)
+{
+    const auto A = juce::jmax (static_cast<NumericType> (0.0), std::sqrt (gainFactor));
+    const auto aminus1 = A - 1;
+    const auto aplus1 = A + 1;
+    const auto omega = (2 * juce::MathConstants<NumericType>::pi * juce::jmax (cutOffFrequency, static_cast<NumericType> (2.0)))
+                     / static_cast<NumericType> (sampleRate);
+    const auto coso = std::cos (omega);
+    const auto beta = std::sin (omega) * std::sqrt (A) / Q;
+    const auto aminus1TimesCoso = aminus1 * coso;
+
+    return makeNormalisedBiquad<NumericType> (A * (aplus1 - aminus1TimesCoso + beta),
+                                              A * 2 * (aminus1 - aplus1 * coso),
+                                              A * (aplus1 - aminus1TimesCoso - beta),
+                                              aplus1 + aminus1TimesCoso + beta,
+                                              -2 * (aminus1 + aplus1 * coso),
+                                              aplus1 + aminus1TimesCoso - beta);
+}
+
+/** As IIR::Coefficients::makeHighShelf. */
+template<typename NumericType>
+BiquadCoefficients<NumericType> makeHighShelfBiquad (double sampleRate, NumericType cutOffFrequency,
+                                                     NumericType Q, NumericType gainFactor)
+{
+    const auto A = juce::jmax (static_cast<NumericType> (0.0), std::sqrt (gainFactor));
+    const auto aminus1 = A - 1;
+    const auto aplus1 = A + 1;
+    const auto omega = (2 * juce::MathConstants<NumericType>::pi * juce::jmax (cutOffFrequency, static_cast<NumericType> (2.0)))
+                     / static_cast<NumericType> (sampleRate);
+    const auto coso = std::cos (omega);
+    const auto beta = std::sin (omega) * std::sqrt (A) / Q;
+    const auto aminus1TimesCoso = aminus1 * coso;
+
+    return makeNormalisedBiquad<NumericType> (A * (aplus1 + aminus1TimesCoso + beta),
+                                              A * -2 * (aminus1 + aplus1 * coso),
+                                              A * (aplus1 + aminus1TimesCoso - beta),
+                                              aplus1 - aminus1TimesCoso + beta,
+                                              2 * (aminus1 - aplus1 * coso),
+                                              aplus1 - aminus1TimesCoso - beta);
+}
+
+/** As IIR::Coefficients::makeNotch. */
+template<typename NumericType>
+BiquadCoefficients<NumericType> makeNotchBiquad (double sampleRate, NumericType frequency, NumericType Q)
+{
+    const auto n = 1 / std::tan (juce::MathConstants<NumericType>::pi * frequency / static_cast<NumericType> (sampleRate));
+    const auto nSquared = n * n;
+    const auto invQ = 1 / Q;
+    const auto c1 = 1 / (1 + n * invQ + nSquared);
+    const auto b0 = c1 * (1 + nSquared);
+    const auto b1 = 2 * c1 * (1 - nSquared);
+
+    return makeNormalisedBiquad<NumericType> (b0, b1, b0, 1, b1, c1 * (1 - n * invQ + nSquared));
+}
+
+/**
+ A high shelf turned down by half its gain, so the spectrum pivots about the
+ frequency: the lows fall by half the gain and the highs rise by half.
+ */
+template<typename NumericType>
+BiquadCoefficients<NumericType> makeTiltBiquad (double sampleRate, NumericType frequency,
+                                                NumericType Q, NumericType gainFactor)
+{
+    auto c = makeHighShelfBiquad (sampleRate, frequency, Q, gainFactor);
+    const auto pivotGain = 1 / std::sqrt (gainFactor);
+
+    c.b0 *= pivotGain;
+    c.b1 *= pivotGain;
+    c.b2 *= pivotGain;
+    return c;
+}
+
+/** Designs one parametric band of the given type. A notch ignores the gain. */
+template<typename NumericType>
+BiquadCoefficients<NumericType> makeBandBiquad (BandType type, double sampleRate, NumericType frequency,
+                                                NumericType Q, NumericType gainInDecibels)
+{
+    const auto gainFactor = juce::Decibels::decibelsToGain (gainInDecibels);
+
+    switch (type)
+    {
+        case Band_LowShelf:  return makeLowShelfBiquad (sampleRate, frequency, Q, gainFactor);
+        case Band_HighShelf: return makeHighShelfBiquad (sampleRate, frequency, Q, gainFactor);
+        case Band_Notch:     return makeNotchBiquad (sampleRate, frequency, Q);
+        case Band_Tilt:      return makeTiltBiquad (sampleRate, frequency, Q, gainFactor);
+        case Band_Bell:      break;
+    }
+
+    return makePeakBiquad (sampleRate, frequency, Q, gainFactor);
+}
+
+/** As IIR::Coefficients::makeLowPass. */
+template<typename NumericType>
+BiquadCoefficients<NumericType> makeLowPassBiquad (double sampleRate, NumericType frequency, NumericType Q)
+{
+    const auto n = 1 / std::tan (juce::MathConstants<NumericType>::pi * frequency / static_cast<NumericType> (sampleRate));
+    const auto nSquared = n * n;
+    const auto invQ = 1 / Q;
+    const auto c1 = 1 / (1 + invQ * n + nSquared);
+
+    return makeNormalisedBiquad<NumericType> (c1, c1 * 2, c1,
+                                              1, c1 * 2 * (1 - nSquared), c1 * (1 - invQ * n + nSquared));
+}
+
+/** As IIR::Coefficients::makeHighPass. */
+template<typename NumericType>
+BiquadCoefficients<NumericType> makeHighPassBiquad (double sampleRate, NumericType frequency, NumericType Q)
+{
+    const auto n = std::tan (juce::MathConstants<NumericType>::pi * frequency / static_cast<NumericType> (sampleRate));
+    const auto nSquared = n * n;
+    const auto invQ = 1 / Q;
+    const auto c1 = 1 / (1 + invQ * n + nSquared);
+
+    return makeNormalisedBiquad<NumericType> (c1, c1 * -2, c1,
+                                              1, c1 * 2 * (nSquared - 1), c1 * (1 - invQ * n + nSquared));
+}
+
+/** Returns the Q of a section of an even-order Butterworth filter, as FilterDesign computes it. */
+template<typename NumericType>
+NumericType getButterworthSectionQ (int section, int order)
+{
+    return static_cast<NumericType> (1.0 / (2.0 * std::cos ((2.0 * section + 1.0) * juce::MathConstants<double>::pi / (order * 2.0))));
+}
+
+/**
+ Returns the Q of a section of an even-order Linkwitz-Riley filter: a
+ Butterworth filter of half the order, twice over. Each of the Butterworth's
+ pole pairs fills two sections; if it has a real pole, that pole squared
+ fills the last, critically damped, section.
+ */
+template<typename NumericType>
+NumericType getLinkwitzRileySectionQ (int section, int order)
+{
+    const auto butterworthOrder = order / 2;
+    const auto pair = section / 2;
+
+    if (pair >= butterworthOrder / 2)
+        return static_cast<NumericType> (0.5);
+
+    //an odd-order Butterworth's pairs sit half a step further round, clear of its real pole
+    const auto angle = (2.0 * pair + 1.0 + (butterworthOrder & 1)) * juce::MathConstants<double>::pi / (butterworthOrder * 2.0);
+    return static_cast<NumericType> (1.0 / (2.0 * std::cos (angle)));
+}
+
+template<typename NumericType>
+NumericType getCutSectionQ (CutType type, int section, int order)
+{
+    return type == Cut_LinkwitzRiley ? getLinkwitzRileySectionQ<NumericType> (section, order)
+                                     : getButterworthSectionQ<NumericType> (section, order);
+}
+
+/**
+ Designs an even-order low-pass cut as order / 2 biquads. The Butterworth
+ cut matches FilterDesign::designIIRLowpassHighOrderButterworthMethod.
+ */
+template<typename NumericType>
+void designLowPassCut (CutCoefficients<NumericType>& dest, CutType type, NumericType frequency, double sampleRate, int order)
+{
+    jassert (order % 2 == 0 && order / 2 <= maxCutFilterSections);
+    dest.numSections = order / 2;
+
+    for (int i = 0; i < dest.numSections; ++i)
+        dest.sections[(size_t) i] = makeLowPassBiquad (sampleRate, frequency, getCutSectionQ<NumericType> (type, i, order));
+}
+
+/**
+ Designs an even-order high-pass cut as order / 2 biquads. The Butterworth
+ cut matches FilterDesign::designIIRHighpassHighOrderButterworthMethod.
+ */
+template<typename NumericType>
+void designHighPassCut (CutCoefficients<NumericType>& dest, CutType type, NumericType frequency, double sampleRate, int order)
+{
+    jassert (order % 2 == 0 && order / 2 <= maxCutFilterSections);
+    dest.numSections = order / 2;
+
+    for (int i = 0; i < dest.numSections; ++i)
+        dest.sections[(size_t) i] = makeHighPassBiquad (sampleRate, frequency, getCutSectionQ<NumericType> (type, i, order));
+}
+
+/**
+ Single producer, single consumer triple buffer.
+ The producer fills getWriteSlot() and calls publish(); the consumer calls
+ acquire() and, if it returns true, reads the newest complete value from
+ getReadSlot(). Both sides are wait-free and never allocate.
+ */
+template<typename Type>
+struct TripleBuffer
+{
+    Type& getWriteSlot() { return slots[writeIndex]; }
+
+    void publish()
+    {
+        writeIndex = shared.exchange (writeIndex | freshFlag, std::memory_order_acq_rel) & indexMask;
+    }
+
+    bool acquire()
+    {
+        if ((shared.load (std::memory_order_relaxed) & freshFlag) == 0)
+            return false;
+
+        readIndex = shared.exchange (readIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    const Type& getReadSlot() const { return slots[readIndex]; }
+
+    /** Applies function to every slot, e.g. to size them. Only call while neither side is using the buffer. */
+    template<typename Function>
+    void forEachSlot (Function&& function)
+    {
+        for (auto& slot : slots)
+            function (slot);
+    }
+private:
+    static constexpr int freshFlag = 4;
+    static constexpr int indexMask = 3;
+
+    std::array<Type, 3> slots;
+    int writeIndex = 0, readIndex = 1;
+    std::atomic<int> shared { 2 };
+};
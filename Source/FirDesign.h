@@ -0,0 +1,226 @@
+/*
+  ==============================================================================
+
+    Turns the chain's magnitude response into an FIR, and remembers the
+    designs it has already made.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FilterCoefficients.h"
+
+/**
+ Designs a linear-phase FIR with the same magnitude as the IIR chain, by
+ frequency sampling: the magnitude is sampled on the FFT grid, given the
+ phase of a pure delay of half the length, transformed back and windowed.
+ prepare() allocates; design() does not.
+ */
+class LinearPhaseFirDesigner
+{
+public:
+    void prepare (int order)
+    {
+        fft = std::make_unique<juce::dsp::FFT> (order);
+        length = fft->getSize();
+        buffer.resize ((size_t) (2 * length));
+
+        //one extra point, so the window is symmetric about the centre tap
+        window.resize ((size_t) (length + 1));
+        juce::dsp::WindowingFunction<float>::fillWindowingTables (window.data(), window.size(),
+                                                                  juce::dsp::WindowingFunction<float>::blackman,
+                                                                  false);
+    }
+
+    int getLength() const { return length; }
+
+    /** The FIR's group delay: its peak sits this many samples in. */
+    int getLatencyInSamples() const { return length / 2; }
+
+    /**
+     Returns the impulse response for the chain, sampled at sampleRate. The
+     chain may have been designed at a higher, oversampled filterSampleRate,
+     in which case its cramping-free response is what gets sampled.
+     */
+    const float* design (const ChainCoefficients<double>& chain, double filterSampleRate, double sampleRate)
+    {
+        for (int bin = 0; bin <= length / 2; ++bin)
+        {
+            auto frequency = bin * sampleRate / length;
+            auto magnitude = getMagnitudeForFrequency (chain, frequency, filterSampleRate);
+
+            //a delay of length / 2 turns every odd bin upside down
+            buffer[(size_t) (2 * bin)] = (float) ((bin & 1) != 0 ? -magnitude : magnitude);
+            buffer[(size_t) (2 * bin + 1)] = 0.f;
+        }
+
+        fft->performRealOnlyInverseTransform (buffer.data());
+        juce::FloatVectorOperations::multiply (buffer.data(), window.data(), length);
+
+        return buffer.data();
+    }
+private:
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> buffer, window;
+    int length = 0;
+};
+
+/**
+ Designs a minimum-phase FIR with the same magnitude as the IIR chain, by
+ the real-cepstrum method: the log magnitude is transformed to its cepstrum,
+ folded onto the causal half and transformed back, which gives the log
+ spectrum of the minimum-phase response. The grid is a few times finer than
+ the FIR is long, so the cepstrum does not alias.
+ prepare() allocates; design() does not.
+ */
+class MinimumPhaseFirDesigner
+{
+public:
+    void prepare (int order)
+    {
+        fft = std::make_unique<juce::dsp::FFT> (order + cepstrumOversamplingOrder);
+        length = 1 << order;
+        spectrum.resize ((size_t) fft->getSize());
+        cepstrum.resize ((size_t) fft->getSize());
+        impulse.resize ((size_t) length);
+
+        //the response starts at its peak, so only the falling half of a window is used
+        std::vector<float> window ((size_t) (2 * length + 1));
+        juce::dsp::WindowingFunction<float>::fillWindowingTables (window.data(), window.size(),
+                                                                  juce::dsp::WindowingFunction<float>::blackman,
+                                                                  false);
+        fade.assign (window.begin() + length, window.begin() + 2 * length);
+    }
+
+    int getLength() const { return length; }
+
+    /** A minimum-phase FIR adds no delay of its own. */
+    int getLatencyInSamples() const { return 0; }
+
+    /** As LinearPhaseFirDesigner::design(). */
+    const float* design (const ChainCoefficients<double>& chain, double filterSampleRate, double sampleRate)
+    {
+        const auto size = fft->getSize();
+
+        for (int bin = 0; bin <= size / 2; ++bin)
+        {
+            auto magnitude = getMagnitudeForFrequency (chain, bin * sampleRate / size, filterSampleRate);
+
+            //a cut's stopband can reach zero, which has no logarithm
+            spectrum[(size_t) bin] = (float) std::log (juce::jmax (magnitude, minimumMagnitude));
+        }
+
+        for (int bin = size / 2 + 1; bin < size; ++bin)
+            spectrum[(size_t) bin] = spectrum[(size_t) (size - bin)];
+
+        fft->perform (spectrum.data(), cepstrum.data(), true);
+
+        //doubling the causal half and dropping the rest makes the phase the
+        //Hilbert transform of the log magnitude
+        for (int n = 1; n < size / 2; ++n)
+            cepstrum[(size_t) n] *= 2.f;
+
+        std::fill (cepstrum.begin() + size / 2 + 1, cepstrum.end(), std::complex<float>());
+
+        fft->perform (cepstrum.data(), spectrum.data(), false);
+
+        for (auto& bin : spectrum)
+            bin = std::exp (bin);
+
+        fft->perform (spectrum.data(), cepstrum.data(), true);
+
+        for (int i = 0; i < length; ++i)
+            impulse[(size_t) i] = cepstrum[(size_t) i].real() * fade[(size_t) i];
+
+        return impulse.data();
+    }
+private:
+    //the cepstrum is taken on a grid 2^this times finer than the FIR's length
+    static constexpr int cepstrumOversamplingOrder = 2;
+
+    //-140 dB, well below anything a float FIR can reproduce
+    static constexpr double minimumMagnitude = 1.0e-7;
+
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<std::complex<float>> spectrum, cepstrum;
+    std::vector<float> impulse, fade;
+    int length = 0;
+};
+
+/** Everything an FIR design depends on, quantised so that inaudibly different settings compare equal. */
+struct FirDesignKey
+{
+    //the cuts, phase, oversampling and rate, then four values for each band
+    static constexpr size_t numChainValues = 9, numBandValues = 4;
+
+    std::array<int, numChainValues + numBandValues * maxBands> values {};
+
+    bool operator== (const FirDesignKey& other) const { return values == other.values; }
+};
+
+/**
+ Remembers the last few FIR designs by key, so returning to a setting - A/B
+ toggling, switching between phase modes, or a host preparing twice while a
+ session loads - copies the impulse instead of designing it again.
+ prepare() allocates; nothing else does.
+ */
+class FirDesignCache
+{
+public:
+    /** Keeps the cached designs if they already have the right length. */
+    void prepare (int impulseLength)
+    {
+        if (impulseLength == length)
+            return;
+
+        length = impulseLength;
+        for (auto& entry : entries)
+        {
+            entry.impulse.assign ((size_t) length, 0.f);
+            entry.lastUse = 0;
+        }
+    }
+
+    /** Returns the cached impulse for the key, or nullptr if it has not been designed. */
+    const float* find (const FirDesignKey& key)
+    {
+        for (auto& entry : entries)
+        {
+            if (entry.lastUse > 0 && entry.key == key)
+            {
+                entry.lastUse = ++useCount;
+                return entry.impulse.data();
+            }
+        }
+
+        return nullptr;
+    }
+
+    /** Stores a copy of the impulse in place of the least recently used design. */
+    void store (const FirDesignKey& key, const float* impulse)
+    {
+        auto& entry = *std::min_element (entries.begin(), entries.end(),
+                                         [] (const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+
+        entry.key = key;
+        std::copy (impulse, impulse + length, entry.impulse.begin());
+        entry.lastUse = ++useCount;
+    }
+private:
+    struct Entry
+    {
+        FirDesignKey key;
+        std::vector<float> impulse;
+
+        //0 for an entry that holds no design
+        juce::uint64 lastUse = 0;
+    };
+
+    static constexpr int numEntries = 8;
+
+    std::array<Entry, numEntries> entries;
+    int length = 0;
+    juce::uint64 useCount = 0;
+};
@@ -0,0 +1,54 @@
+/*
+  ==============================================================================
+
+    The hot loops, built once per instruction set, as a table of plain
+    function pointers that CpuDispatch picks between at run time.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstddef>
+
+/**
+ One instruction set's build of the kernels. The units that build them are
+ compiled with that instruction set enabled, and include nothing from JUCE:
+ anything inline they emitted could be chosen by the linker for every other
+ caller, which would then need the wider instruction set too.
+ */
+struct KernelTable
+{
+    const char* name;
+    int floatLanes, doubleLanes;
+
+    /**
+     Runs numSections biquads in series over interleaved samples, one channel
+     per lane. Each section is b0, b1, b2, a1, a2 and each state s1, s2, every
+     value a full register of lanes. The operations are the ones
+     processCascade() does, in the same order, so the results match it bit
+     for bit.
+     */
+    void (*cascadeFloat) (float* samples, size_t numSamples, const float* sections, float* states, int numSections);
+    void (*cascadeDouble) (double* samples, size_t numSamples, const double* sections, double* states, int numSections);
+
+    /**
+     Scales FFT magnitudes and converts them to decibels, floored at
+     negativeInfinity. A value that is not finite and positive comes out as
+     negativeInfinity. The logarithm is approximated to about 1e-4 dB.
+     */
+    void (*magnitudesToDecibels) (float* values, int numValues, float scale, float negativeInfinity);
+
+    /**
+     Writes the gain of numSections biquads (b0, b1, b2, a1, a2 each) at
+     every point, given cos w, sin w, cos 2w and sin 2w of its angular frequency.
+     */
+    void (*chainMagnitudes) (const double* cos1, const double* sin1, const double* cos2, const double* sin2,
+                             int numPoints, const double* sections, int numSections, double* magnitudes);
+};
+
+//each returns nullptr if its unit was built without its instruction set
+const KernelTable* getGenericKernels();
+const KernelTable* getSse2Kernels();
+const KernelTable* getAvx2Kernels();
+const KernelTable* getAvx512Kernels();
@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    The kernels built for AVX2, eight floats or four doubles per register.
+    This unit is compiled with -mavx2 (see the AVX2 compiler flag scheme),
+    with contraction into FMAs left off so its cascade matches the others.
+
+  ==============================================================================
+*/
+
+#include "KernelTable.h"
+
+#if defined (__AVX2__)
+
+#include <immintrin.h>
+#include <limits>
+#include "KernelsImpl.h"
+
+namespace
+{
+
+struct Avx2FloatOps
+{
+    using Vector = __m256;
+    using Element = float;
+    static constexpr int lanes = 8;
+
+    static Vector load (const float* source)             { return _mm256_loadu_ps (source); }
+    static void store (float* dest, Vector value)        { _mm256_storeu_ps (dest, value); }
+    static Vector expand (float value)                   { return _mm256_set1_ps (value); }
+    static Vector add (Vector a, Vector b)                { return _mm256_add_ps (a, b); }
+    static Vector sub (Vector a, Vector b)                { return _mm256_sub_ps (a, b); }
+    static Vector mul (Vector a, Vector b)                { return _mm256_mul_ps (a, b); }
+    static Vector div (Vector a, Vector b)                { return _mm256_div_ps (a, b); }
+    static Vector max (Vector a, Vector b)                { return _mm256_max_ps (a, b); }
+    static Vector sqrt (Vector a)                         { return _mm256_sqrt_ps (a); }
+
+    static Vector selectFinitePositive (Vector value, Vector whenTrue, Vector whenFalse)
+    {
+        auto mask = _mm256_and_ps (_mm256_cmp_ps (value, _mm256_setzero_ps(), _CMP_GT_OQ),
+                                   _mm256_cmp_ps (value, _mm256_set1_ps (std::numeric_limits<float>::max()), _CMP_LE_OQ));
+        return _mm256_blendv_ps (whenFalse, whenTrue, mask);
+    }
+
+    static void split (Vector value, Vector& exponent, Vector& mantissa)
+    {
+        auto bits = _mm256_castps_si256 (value);
+        exponent = _mm256_cvtepi32_ps (_mm256_sub_epi32 (_mm256_srli_epi32 (bits, 23), _mm256_set1_epi32 (127)));
+        bits = _mm256_or_si256 (_mm256_and_si256 (bits, _mm256_set1_epi32 (0x7fffff)), _mm256_set1_epi32 (0x3f800000));
+        mantissa = _mm256_castsi256_ps (bits);
+    }
+};
+
+struct Avx2DoubleOps
+{
+    using Vector = __m256d;
+    using Element = double;
+    static constexpr int lanes = 4;
+
+    static Vector load (const double* source)            { return _mm256_loadu_pd (source); }
+    static void store (double* dest, Vector value)       { _mm256_storeu_pd (dest, value); }
+    static Vector expand (double value)                  { return _mm256_set1_pd (value); }
+    static Vector add (Vector a, Vector b)                { return _mm256_add_pd (a, b); }
+    static Vector sub (Vector a, Vector b)                { return _mm256_sub_pd (a, b); }
+    static Vector mul (Vector a, Vector b)                { return _mm256_mul_pd (a, b); }
+    static Vector div (Vector a, Vector b)                { return _mm256_div_pd (a, b); }
+    static Vector sqrt (Vector a)                         { return _mm256_sqrt_pd (a); }
+};
+
+const KernelTable avx2Kernels = makeKernelTable<Avx2FloatOps, Avx2DoubleOps> ("AVX2");
+
+} // namespace
+
+const KernelTable* getAvx2Kernels()     { return &avx2Kernels; }
+
+#else
+
+const KernelTable* getAvx2Kernels()     { return nullptr; }
+
+#endif
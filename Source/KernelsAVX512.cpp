@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    The kernels built for AVX-512, sixteen floats or eight doubles per
+    register. This unit is compiled with -mavx512f (see the AVX512 compiler
+    flag scheme), with contraction into FMAs left off as for AVX2.
+
+  ==============================================================================
+*/
+
+#include "KernelTable.h"
+
+#if defined (__AVX512F__)
+
+#include <immintrin.h>
+#include <limits>
+#include "KernelsImpl.h"
+
+namespace
+{
+
+struct Avx512FloatOps
+{
+    using Vector = __m512;
+    using Element = float;
+    static constexpr int lanes = 16;
+
+    static Vector load (const float* source)             { return _mm512_loadu_ps (source); }
+    static void store (float* dest, Vector value)        { _mm512_storeu_ps (dest, value); }
+    static Vector expand (float value)                   { return _mm512_set1_ps (value); }
+    static Vector add (Vector a, Vector b)                { return _mm512_add_ps (a, b); }
+    static Vector sub (Vector a, Vector b)                { return _mm512_sub_ps (a, b); }
+    static Vector mul (Vector a, Vector b)                { return _mm512_mul_ps (a, b); }
+    static Vector div (Vector a, Vector b)                { return _mm512_div_ps (a, b); }
+    static Vector max (Vector a, Vector b)                { return _mm512_max_ps (a, b); }
+    static Vector sqrt (Vector a)                         { return _mm512_sqrt_ps (a); }
+
+    static Vector selectFinitePositive (Vector value, Vector whenTrue, Vector whenFalse)
+    {
+        auto mask = _mm512_cmp_ps_mask (value, _mm512_setzero_ps(), _CMP_GT_OQ)
+                  & _mm512_cmp_ps_mask (value, _mm512_set1_ps (std::numeric_limits<float>::max()), _CMP_LE_OQ);
+        return _mm512_mask_blend_ps (mask, whenFalse, whenTrue);
+    }
+
+    static void split (Vector value, Vector& exponent, Vector& mantissa)
+    {
+        auto bits = _mm512_castps_si512 (value);
+        exponent = _mm512_cvtepi32_ps (_mm512_sub_epi32 (_mm512_srli_epi32 (bits, 23), _mm512_set1_epi32 (127)));
+        bits = _mm512_or_si512 (_mm512_and_si512 (bits, _mm512_set1_epi32 (0x7fffff)), _mm512_set1_epi32 (0x3f800000));
+        mantissa = _mm512_castsi512_ps (bits);
+    }
+};
+
+struct Avx512DoubleOps
+{
+    using Vector = __m512d;
+    using Element = double;
+    static constexpr int lanes = 8;
+
+    static Vector load (const double* source)            { return _mm512_loadu_pd (source); }
+    static void store (double* dest, Vector value)       { _mm512_storeu_pd (dest, value); }
+    static Vector expand (double value)                  { return _mm512_set1_pd (value); }
+    static Vector add (Vector a, Vector b)                { return _mm512_add_pd (a, b); }
+    static Vector sub (Vector a, Vector b)                { return _mm512_sub_pd (a, b); }
+    static Vector mul (Vector a, Vector b)                { return _mm512_mul_pd (a, b); }
+    static Vector div (Vector a, Vector b)                { return _mm512_div_pd (a, b); }
+    static Vector sqrt (Vector a)                         { return _mm512_sqrt_pd (a); }
+};
+
+const KernelTable avx512Kernels = makeKernelTable<Avx512FloatOps, Avx512DoubleOps> ("AVX-512");
+
+} // namespace
+
+const KernelTable* getAvx512Kernels()   { return &avx512Kernels; }
+
+#else
+
+const KernelTable* getAvx512Kernels()   { return nullptr; }
+
+#endif
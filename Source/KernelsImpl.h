@@ -0,0 +1,240 @@
+/*
+  ==============================================================================
+
+    The bodies of the KernelTable kernels, written once against an Ops type
+    that wraps one instruction set's registers. Only the kernel units
+    include this, after the headers their Ops need.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include "KernelTable.h"
+
+//everything here has internal linkage, so each unit keeps its own build of it
+namespace
+{
+
+/** The Ops for plain scalars: the generic kernels, and every kernel's leftover samples. */
+template<typename Scalar>
+struct ScalarOps
+{
+    using Vector = Scalar;
+    using Element = Scalar;
+    static constexpr int lanes = 1;
+
+    static Vector load (const Scalar* source)            { return *source; }
+    static void store (Scalar* dest, Vector value)       { *dest = value; }
+    static Vector expand (Scalar value)                  { return value; }
+    static Vector add (Vector a, Vector b)                { return a + b; }
+    static Vector sub (Vector a, Vector b)                { return a - b; }
+    static Vector mul (Vector a, Vector b)                { return a * b; }
+    static Vector div (Vector a, Vector b)                { return a / b; }
+    static Vector max (Vector a, Vector b)                { return a < b ? b : a; }
+    static Vector sqrt (Vector a)                         { return std::sqrt (a); }
+
+    /** Returns whenTrue where value is finite and above zero, and whenFalse elsewhere. */
+    static Vector selectFinitePositive (Vector value, Vector whenTrue, Vector whenFalse)
+    {
+        return value > 0 && value <= std::numeric_limits<Scalar>::max() ? whenTrue : whenFalse;
+    }
+
+    /** Splits a positive float into its exponent and a mantissa in [1, 2). */
+    static void split (Vector value, Vector& exponent, Vector& mantissa)
+    {
+        static_assert (sizeof (Scalar) == sizeof (std::uint32_t), "Only floats are split");
+
+        std::uint32_t bits;
+        std::memcpy (&bits, &value, sizeof (bits));
+        exponent = (Scalar) ((int) (bits >> 23) - 127);
+        bits = (bits & 0x7fffffu) | 0x3f800000u;
+        std::memcpy (&mantissa, &bits, sizeof (bits));
+    }
+};
+
+template<typename Ops>
+struct CascadeKernels
+{
+    using Scalar = typename Ops::Element;
+    using Vector = typename Ops::Vector;
+    static constexpr int lanes = Ops::lanes;
+
+    //NumSections sections in series, every sample through all of them before the next
+    template<int NumSections>
+    static void runSections (Scalar* samples, size_t numSamples, const Scalar* sections, Scalar* states)
+    {
+        Vector b0[NumSections], b1[NumSections], b2[NumSections], a1[NumSections], a2[NumSections];
+        Vector s1[NumSections], s2[NumSections];
+
+        for (int k = 0; k < NumSections; ++k)
+        {
+            const auto* c = sections + k * 5 * lanes;
+            b0[k] = Ops::load (c);
+            b1[k] = Ops::load (c + lanes);
+            b2[k] = Ops::load (c + 2 * lanes);
+            a1[k] = Ops::load (c + 3 * lanes);
+            a2[k] = Ops::load (c + 4 * lanes);
+            s1[k] = Ops::load (states + k * 2 * lanes);
+            s2[k] = Ops::load (states + k * 2 * lanes + lanes);
+        }
+
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            auto input = Ops::load (samples + i * lanes);
+
+            for (int k = 0; k < NumSections; ++k)
+            {
+                auto output = Ops::add (Ops::mul (input, b0[k]), s1[k]);
+                s1[k] = Ops::add (Ops::sub (Ops::mul (input, b1[k]), Ops::mul (output, a1[k])), s2[k]);
+                s2[k] = Ops::sub (Ops::mul (input, b2[k]), Ops::mul (output, a2[k]));
+                input = output;
+            }
+
+            Ops::store (samples + i * lanes, input);
+        }
+
+        for (int k = 0; k < NumSections; ++k)
+        {
+            Ops::store (states + k * 2 * lanes, s1[k]);
+            Ops::store (states + k * 2 * lanes + lanes, s2[k]);
+        }
+    }
+
+    /**
+     Takes the sections four at a time: the count is only known at run time,
+     and four keeps every state in a register while still giving the CPU
+     independent work to overlap.
+     */
+    static void cascade (Scalar* samples, size_t numSamples, const Scalar* sections, Scalar* states, int numSections)
+    {
+        int k = 0;
+        for (; k + 4 <= numSections; k += 4)
+            runSections<4> (samples, numSamples, sections + k * 5 * lanes, states + k * 2 * lanes);
+
+        switch (numSections - k)
+        {
+            case 3: runSections<3> (samples, numSamples, sections + k * 5 * lanes, states + k * 2 * lanes); break;
+            case 2: runSections<2> (samples, numSamples, sections + k * 5 * lanes, states + k * 2 * lanes); break;
+            case 1: runSections<1> (samples, numSamples, sections + k * 5 * lanes, states + k * 2 * lanes); break;
+            default: break;
+        }
+
+        //as snapToZero(), so denormals never build up in the states
+        for (int i = 0; i < numSections * 2 * lanes; ++i)
+            if (! (states[i] < -1.0e-8f || states[i] > 1.0e-8f))
+                states[i] = 0;
+    }
+};
+
+template<typename Ops>
+struct AnalyzerKernels
+{
+    using Vector = typename Ops::Vector;
+    static constexpr int lanes = Ops::lanes;
+
+    static Vector toDecibels (Vector value, Vector negativeInfinity)
+    {
+        //log2 of the mantissa m from the series for atanh, in t = (m - 1) / (m + 1), which stays within 1/3
+        Vector exponent, mantissa;
+        Ops::split (value, exponent, mantissa);
+
+        const auto one = Ops::expand (1.f);
+        auto t = Ops::div (Ops::sub (mantissa, one), Ops::add (mantissa, one));
+        auto t2 = Ops::mul (t, t);
+
+        auto series = Ops::add (Ops::expand (1.f / 7.f), Ops::mul (t2, Ops::expand (1.f / 9.f)));
+        series = Ops::add (Ops::expand (1.f / 5.f), Ops::mul (t2, series));
+        series = Ops::add (Ops::expand (1.f / 3.f), Ops::mul (t2, series));
+        series = Ops::add (one, Ops::mul (t2, series));
+
+        //20 log10 (x) = 20 log10 (2) log2 (x), and log2 (m) = 2 t series / ln 2
+        const auto twiceInverseLn2 = Ops::expand (2.88539008f);
+        const auto decibelsPerOctave = Ops::expand (6.02059991f);
+        auto log2 = Ops::add (exponent, Ops::mul (twiceInverseLn2, Ops::mul (t, series)));
+
+        auto decibels = Ops::max (negativeInfinity, Ops::mul (decibelsPerOctave, log2));
+        return Ops::selectFinitePositive (value, decibels, negativeInfinity);
+    }
+
+    static void magnitudesToDecibels (float* values, int numValues, float scale, float negativeInfinity)
+    {
+        const auto scaleVector = Ops::expand (scale);
+        const auto floorVector = Ops::expand (negativeInfinity);
+
+        int i = 0;
+        for (; i + lanes <= numValues; i += lanes)
+            Ops::store (values + i, toDecibels (Ops::mul (Ops::load (values + i), scaleVector), floorVector));
+
+        for (; i < numValues; ++i)
+            values[i] = AnalyzerKernels<ScalarOps<float>>::toDecibels (values[i] * scale, negativeInfinity);
+    }
+};
+
+template<typename Ops>
+struct ResponseKernels
+{
+    using Vector = typename Ops::Vector;
+    static constexpr int lanes = Ops::lanes;
+
+    static Vector magnitudeAt (const double* cosine1, const double* sine1, const double* cosine2, const double* sine2,
+                               const double* sections, int numSections)
+    {
+        const auto c1 = Ops::load (cosine1), s1 = Ops::load (sine1);
+        const auto c2 = Ops::load (cosine2), s2 = Ops::load (sine2);
+        const auto one = Ops::expand (1.0);
+        auto squaredMagnitude = one;
+
+        for (int k = 0; k < numSections; ++k)
+        {
+            const auto* c = sections + k * 5;
+            const auto b0 = Ops::expand (c[0]), b1 = Ops::expand (c[1]), b2 = Ops::expand (c[2]);
+            const auto a1 = Ops::expand (c[3]), a2 = Ops::expand (c[4]);
+
+            //with z = e^-jw: b0 + b1 z + b2 z^2 over 1 + a1 z + a2 z^2
+            auto numeratorReal = Ops::add (b0, Ops::add (Ops::mul (b1, c1), Ops::mul (b2, c2)));
+            auto numeratorImag = Ops::add (Ops::mul (b1, s1), Ops::mul (b2, s2));
+            auto denominatorReal = Ops::add (one, Ops::add (Ops::mul (a1, c1), Ops::mul (a2, c2)));
+            auto denominatorImag = Ops::add (Ops::mul (a1, s1), Ops::mul (a2, s2));
+
+            auto numerator = Ops::add (Ops::mul (numeratorReal, numeratorReal), Ops::mul (numeratorImag, numeratorImag));
+            auto denominator = Ops::add (Ops::mul (denominatorReal, denominatorReal), Ops::mul (denominatorImag, denominatorImag));
+
+            //a ratio per section, so a long chain of deep cuts cannot underflow
+            squaredMagnitude = Ops::mul (squaredMagnitude, Ops::div (numerator, denominator));
+        }
+
+        return Ops::sqrt (squaredMagnitude);
+    }
+
+    static void chainMagnitudes (const double* cos1, const double* sin1, const double* cos2, const double* sin2,
+                                 int numPoints, const double* sections, int numSections, double* magnitudes)
+    {
+        int i = 0;
+        for (; i + lanes <= numPoints; i += lanes)
+            Ops::store (magnitudes + i, magnitudeAt (cos1 + i, sin1 + i, cos2 + i, sin2 + i, sections, numSections));
+
+        for (; i < numPoints; ++i)
+            magnitudes[i] = ResponseKernels<ScalarOps<double>>::magnitudeAt (cos1 + i, sin1 + i, cos2 + i, sin2 + i,
+                                                                            sections, numSections);
+    }
+};
+
+/** Builds the table for a float Ops and a double Ops of the same instruction set. */
+template<typename FloatOps, typename DoubleOps>
+KernelTable makeKernelTable (const char* name)
+{
+    return { name,
+             FloatOps::lanes,
+             DoubleOps::lanes,
+             &CascadeKernels<FloatOps>::cascade,
+             &CascadeKernels<DoubleOps>::cascade,
+             &AnalyzerKernels<FloatOps>::magnitudesToDecibels,
+             &ResponseKernels<DoubleOps>::chainMagnitudes };
+}
+
+} // namespace
@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    The kernels built for SSE2, four floats or two doubles per register.
+    This unit is compiled with -msse2 (see the SSE2 compiler flag scheme).
+
+  ==============================================================================
+*/
+
+#include "KernelTable.h"
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+#include <limits>
+#include "KernelsImpl.h"
+
+namespace
+{
+
+struct Sse2FloatOps
+{
+    using Vector = __m128;
+    using Element = float;
+    static constexpr int lanes = 4;
+
+    static Vector load (const float* source)             { return _mm_loadu_ps (source); }
+    static void store (float* dest, Vector value)        { _mm_storeu_ps (dest, value); }
+    static Vector expand (float value)                   { return _mm_set1_ps (value); }
+    static Vector add (Vector a, Vector b)                { return _mm_add_ps (a, b); }
+    static Vector sub (Vector a, Vector b)                { return _mm_sub_ps (a, b); }
+    static Vector mul (Vector a, Vector b)                { return _mm_mul_ps (a, b); }
+    static Vector div (Vector a, Vector b)                { return _mm_div_ps (a, b); }
+    static Vector max (Vector a, Vector b)                { return _mm_max_ps (a, b); }
+    static Vector sqrt (Vector a)                         { return _mm_sqrt_ps (a); }
+
+    static Vector selectFinitePositive (Vector value, Vector whenTrue, Vector whenFalse)
+    {
+        auto mask = _mm_and_ps (_mm_cmpgt_ps (value, _mm_setzero_ps()),
+                                _mm_cmple_ps (value, _mm_set1_ps (std::numeric_limits<float>::max())));
+        return _mm_or_ps (_mm_and_ps (mask, whenTrue), _mm_andnot_ps (mask, whenFalse));
+    }
+
+    static void split (Vector value, Vector& exponent, Vector& mantissa)
+    {
+        auto bits = _mm_castps_si128 (value);
+        exponent = _mm_cvtepi32_ps (_mm_sub_epi32 (_mm_srli_epi32 (bits, 23), _mm_set1_epi32 (127)));
+        bits = _mm_or_si128 (_mm_and_si128 (bits, _mm_set1_epi32 (0x7fffff)), _mm_set1_epi32 (0x3f800000));
+        mantissa = _mm_castsi128_ps (bits);
+    }
+};
+
+struct Sse2DoubleOps
+{
+    using Vector = __m128d;
+    using Element = double;
+    static constexpr int lanes = 2;
+
+    static Vector load (const double* source)            { return _mm_loadu_pd (source); }
+    static void store (double* dest, Vector value)       { _mm_storeu_pd (dest, value); }
+    static Vector expand (double value)                  { return _mm_set1_pd (value); }
+    static Vector add (Vector a, Vector b)                { return _mm_add_pd (a, b); }
+    static Vector sub (Vector a, Vector b)                { return _mm_sub_pd (a, b); }
+    static Vector mul (Vector a, Vector b)                { return _mm_mul_pd (a, b); }
+    static Vector div (Vector a, Vector b)                { return _mm_div_pd (a, b); }
+    static Vector sqrt (Vector a)                         { return _mm_sqrt_pd (a); }
+};
+
+const KernelTable sse2Kernels = makeKernelTable<Sse2FloatOps, Sse2DoubleOps> ("SSE2");
+
+} // namespace
+
+const KernelTable* getSse2Kernels()     { return &sse2Kernels; }
+
+#else
+
+const KernelTable* getSse2Kernels()     { return nullptr; }
+
+#endif
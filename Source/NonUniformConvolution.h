@@ -0,0 +1,742 @@
+/*
+  ==============================================================================
+
+    Zero-latency convolution for long FIRs: a direct-form head followed by
+    partitions that grow in length, the longest of them computed on a
+    background thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PartitionedConvolution.h"
+
+/**
+ How a long FIR is split. The first headLength taps run directly in the
+ time domain. The rest go to stages of uniform partitions, each stage's
+ partitions four times longer than the last.
+
+ The first stage starts one partition in, so its overlap-save output lines
+ up with the head. Every later stage starts two partitions in: its result
+ is only needed a whole period after its input is complete, which is the
+ time it has to compute it. Stages long enough to be offloaded start three
+ partitions in, so the worker has two periods, and the audio thread never
+ has to wait for it.
+ */
+struct NonUniformLayout
+{
+    static constexpr int headLength = minPartitionLength;
+    static constexpr int maxStages = 4;
+
+    //stages this long or longer have at least a few milliseconds for their job at any sample rate
+    static constexpr int minOffloadedPartitionLength = 1024;
+
+    struct Stage
+    {
+        int partitionLength = 0, offset = 0, numPartitions = 0;
+
+        /** The number of periods the stage's result waits before it is played: 0, 1 or 2. */
+        int getOutputDelay() const { return offset / partitionLength - 1; }
+
+        bool isOffloaded() const { return partitionLength >= minOffloadedPartitionLength; }
+    };
+
+    static NonUniformLayout forLength (int length)
+    {
+        NonUniformLayout layout;
+        auto partitionLength = headLength, offset = headLength;
+
+        while (offset < length && layout.numStages < maxStages)
+        {
+            //the next stage starts two or three of its own partitions in, i.e. 8 or 12 of these
+            auto nextStartsAt = (4 * partitionLength >= minOffloadedPartitionLength ? 3 : 2) * 4 * partitionLength;
+            auto isLastStage = layout.numStages == maxStages - 1;
+            auto end = isLastStage ? length : juce::jmin (length, nextStartsAt);
+            auto numPartitions = PartitionedKernel::getNumPartitions (end - offset, partitionLength);
+
+            layout.stages[(size_t) layout.numStages++] = { partitionLength, offset, numPartitions };
+            offset += numPartitions * partitionLength;
+            partitionLength *= 4;
+        }
+
+        return layout;
+    }
+
+    bool operator== (const NonUniformLayout& other) const
+    {
+        if (numStages != other.numStages)
+            return false;
+
+        for (int i = 0; i < numStages; ++i)
+        {
+            const auto& a = stages[(size_t) i];
+            const auto& b = other.stages[(size_t) i];
+            if (a.partitionLength != b.partitionLength || a.offset != b.offset || a.numPartitions != b.numPartitions)
+                return false;
+        }
+
+        return true;
+    }
+
+    std::array<Stage, maxStages> stages {};
+    int numStages = 0;
+};
+
+/** An FIR laid out for NonUniformConvolver: head taps, then one partitioned kernel per stage. */
+class NonUniformKernel
+{
+public:
+    void prepare (int maximumLength)
+    {
+        auto largest = NonUniformLayout::forLength (maximumLength);
+
+        for (int i = 0; i < NonUniformLayout::maxStages; ++i)
+        {
+            const auto& stage = largest.stages[(size_t) i];
+            auto partitionLength = stage.partitionLength > 0 ? stage.partitionLength : minPartitionLength;
+            stageKernels[(size_t) i].prepare (stage.numPartitions * partitionLength, partitionLength);
+        }
+
+        maxLength = maximumLength;
+        layout = {};
+        length = 0;
+    }
+
+    void design (const float* impulse, int impulseLength, PartitionTransforms& transforms)
+    {
+        jassert (impulseLength <= maxLength);
+
+        layout = NonUniformLayout::forLength (impulseLength);
+        length = impulseLength;
+
+        //stored reversed, so the head is a plain dot product with the input history
+        reversedHead.fill (0.f);
+        for (int i = 0; i < juce::jmin (length, NonUniformLayout::headLength); ++i)
+            reversedHead[(size_t) (NonUniformLayout::headLength - 1 - i)] = impulse[i];
+
+        for (int i = 0; i < NonUniformLayout::maxStages; ++i)
+        {
+            const auto& stage = layout.stages[(size_t) i];
+            auto stageLength = i < layout.numStages ? juce::jmin (stage.numPartitions * stage.partitionLength, length - stage.offset) : 0;
+            stageKernels[(size_t) i].design (impulse + stage.offset, stageLength, juce::jmax (stage.partitionLength, minPartitionLength), transforms);
+        }
+    }
+
+    void copyFrom (const NonUniformKernel& other)
+    {
+        layout = other.layout;
+        length = other.length;
+        reversedHead = other.reversedHead;
+
+        for (size_t i = 0; i < stageKernels.size(); ++i)
+            stageKernels[i].copyFrom (other.stageKernels[i]);
+    }
+
+    bool isEmpty() const { return length == 0; }
+    int getLength() const { return length; }
+    const NonUniformLayout& getLayout() const { return layout; }
+    const float* getReversedHead() const { return reversedHead.data(); }
+    const PartitionedKernel& getStageKernel (int stage) const { return stageKernels[(size_t) stage]; }
+private:
+    NonUniformLayout layout;
+    std::array<float, NonUniformLayout::headLength> reversedHead {};
+    std::array<PartitionedKernel, NonUniformLayout::maxStages> stageKernels;
+    int length = 0, maxLength = 0;
+};
+
+
+/**
+ Runs every channel through one shared FIR with no added latency.
+
+ The head is convolved sample by sample. Each stage gathers a partition of
+ input and convolves it by overlap-save; the short stages do so on the
+ audio thread, the long ones hand the work to a background thread, which
+ runs each stage's jobs in order.
+
+ The audio thread wakes the worker with a signal, which returns at once,
+ and never waits for it. A result that is not ready
+ when it is due is played as silence, and a stage that finds the worker a
+ whole period behind starts over from an empty history once the worker has
+ let go of it. Only an offline render, which has no deadline, waits.
+
+ The worker is started with setWorkerEnabled(), from a thread other than
+ the audio thread; without it, every stage is computed on the audio thread.
+
+ A new kernel is crossfaded in part by part: the head over its length and
+ each stage over its first period after the change. While that is under
+ way, canAcceptKernel() returns false and the next kernel has to wait. The
+ first kernel after a reset() takes over outright, with nothing to fade from.
+ */
+class NonUniformConvolver
+{
+public:
+    NonUniformConvolver() = default;
+    ~NonUniformConvolver() { release(); }
+
+    void prepare (size_t numChannels, int maximumKernelLength)
+    {
+        release();
+
+        for (auto& kernel : kernels)
+            kernel.prepare (maximumKernelLength);
+
+        auto largest = NonUniformLayout::forLength (maximumKernelLength);
+
+        channels.resize (numChannels);
+        for (auto& channel : channels)
+        {
+            for (int i = 0; i < largest.numStages; ++i)
+            {
+                const auto& stage = largest.stages[(size_t) i];
+                auto& state = channel.stages[(size_t) i];
+
+                state.delayLine.prepare (PartitionedKernel::getNumFloats (stage.numPartitions * stage.partitionLength, stage.partitionLength));
+                state.input.resize ((size_t) (2 * stage.partitionLength));
+                state.playing.resize ((size_t) stage.partitionLength);
+
+                for (auto& slot : state.slots)
+                {
+                    slot.input.resize ((size_t) (2 * stage.partitionLength));
+                    slot.result.resize ((size_t) stage.partitionLength);
+                }
+            }
+        }
+
+        for (auto* executor : { &audioExecutor, &worker.executor })
+            executor->fadingOut.resize ((size_t) maxPartitionLength);
+
+        reset();
+    }
+
+    void release()
+    {
+        setWorkerEnabled (false);
+    }
+
+    /** Starts or stops the thread the long stages are computed on. Not for the audio thread. */
+    void setWorkerEnabled (bool shouldBeEnabled)
+    {
+        if (shouldBeEnabled == worker.isThreadRunning())
+            return;
+
+        if (shouldBeEnabled)
+        {
+            worker.startThread();
+            return;
+        }
+
+        worker.signalThreadShouldExit();
+        worker.notify();
+        worker.stopThread (1000);
+    }
+
+    /** Offline, every stage is computed on the calling thread, which waits for anything the worker still holds. */
+    void setRealtime (bool shouldBeRealtime) { realtime = shouldBeRealtime; }
+
+    void reset()
+    {
+        for (auto& channel : channels)
+        {
+            channel.history.fill (0.f);
+
+            for (auto& state : channel.stages)
+                for (auto* buffer : { &state.input, &state.playing })
+                    std::fill (buffer->begin(), buffer->end(), 0.f);
+        }
+
+        for (int i = 0; i < NonUniformLayout::maxStages; ++i)
+        {
+            auto& stage = stages[(size_t) i];
+            stage.phase = 0;
+            stage.fadePending = false;
+
+            //the delay lines may still be in the worker's hands, so they are cleared once it is done
+            beginResync (i);
+        }
+
+        position = 0;
+        headFadeRemaining = 0;
+        transitionRemaining = 0;
+        playing = false;
+    }
+
+    /** False while a kernel change is still being faded in, or while a job may still read the old kernels. */
+    bool canAcceptKernel() const { return transitionRemaining <= 0 && ! hasJobsInFlight(); }
+
+    void setKernel (const NonUniformKernel& kernel)
+    {
+        jassert (canAcceptKernel());
+
+        //the FIR length is fixed, so a new layout is only ever the first kernel; nothing heard since a reset needs no fade either
+        if (! (kernel.getLayout() == current().getLayout()) || current().isEmpty() || ! playing)
+        {
+            current().copyFrom (kernel);
+            reset();
+            return;
+        }
+
+        currentKernel ^= 1;
+        current().copyFrom (kernel);
+
+        headFadeRemaining = NonUniformLayout::headLength;
+
+        const auto& layout = current().getLayout();
+        int longestPartition = 0, longestDelay = 0;
+        for (int i = 0; i < layout.numStages; ++i)
+        {
+            stages[(size_t) i].fadePending = true;
+            longestPartition = layout.stages[(size_t) i].partitionLength;
+            longestDelay = layout.stages[(size_t) i].getOutputDelay();
+        }
+
+        //a stage may wait up to a period to launch, and its result plays over a period, up to two periods after that
+        transitionRemaining = NonUniformLayout::headLength + (2 + longestDelay) * longestPartition;
+    }
+
+    int getLatencyInSamples() const { return 0; }
+
+    template<typename SampleType>
+    void process (const juce::dsp::AudioBlock<SampleType>& block)
+    {
+        jassert (block.getNumChannels() <= channels.size());
+
+        const auto& layout = current().getLayout();
+        auto numSamples = (int) block.getNumSamples();
+        playing = true;
+
+        //every stage boundary falls on a head boundary, so work in head-length chunks
+        for (int start = 0; start < numSamples;)
+        {
+            auto numToProcess = juce::jmin (numSamples - start, NonUniformLayout::headLength - position);
+
+            for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+                processChunk (block.getChannelPointer (ch) + start, numToProcess, channels[ch], layout);
+
+            headFadeRemaining = juce::jmax (0, headFadeRemaining - numToProcess);
+            transitionRemaining -= numToProcess;
+            position += numToProcess;
+            start += numToProcess;
+
+            for (int i = 0; i < layout.numStages; ++i)
+            {
+                auto& stage = stages[(size_t) i];
+                stage.phase += numToProcess;
+
+                if (stage.phase == layout.stages[(size_t) i].partitionLength)
+                {
+                    stage.phase = 0;
+                    finishPeriod (i, block.getNumChannels());
+                }
+            }
+
+            if (position == NonUniformLayout::headLength)
+                position = 0;
+        }
+    }
+private:
+    enum JobState
+    {
+        idle,
+        pending,
+        running,
+        done
+    };
+
+    //one job being computed, one waiting to be, and one waiting to be played, for the stages with two periods' delay
+    static constexpr int numJobSlots = 3;
+
+    struct JobSlot
+    {
+        std::atomic<int> state { idle };
+        juce::uint32 sequence = 0;  //the job's number within the stage
+        int kernel = 0;             //the kernel the job convolves with
+        bool fades = false;         //the job blends in from the other kernel
+        size_t numChannels = 0;
+    };
+
+    struct StageState
+    {
+        std::array<JobSlot, numJobSlots> slots;
+        juce::uint32 launched = 0;                    //jobs handed out, which is the number of the next
+        std::atomic<juce::uint32> completed { 0 };    //jobs finished, always the oldest ones
+        bool fadePending = false;                     //the next job to launch should blend
+        bool resyncing = false;                       //silent until the worker has let go of the stage
+        int phase = 0;                                //samples into the current period
+    };
+
+    struct ChannelSlot
+    {
+        std::vector<float> input;       //a snapshot of the stage's input for the job
+        std::vector<float> result;      //the job's output, waiting for its period
+    };
+
+    struct ChannelStage
+    {
+        SpectrumDelayLine delayLine;
+        std::vector<float> input;       //the previous and the current partition, as it arrives
+        std::vector<float> playing;     //the result being played out
+        std::array<ChannelSlot, numJobSlots> slots;
+    };
+
+    struct ChannelState
+    {
+        //the last headLength - 1 samples, then the current chunk
+        std::array<float, 2 * NonUniformLayout::headLength> history {};
+        std::array<ChannelStage, NonUniformLayout::maxStages> stages;
+    };
+
+    /** What a thread needs to compute a stage. */
+    struct Executor
+    {
+        PartitionTransforms transforms;
+        std::vector<float> fadingOut;
+    };
+
+    struct Worker : juce::Thread
+    {
+        Worker (NonUniformConvolver& ownerToUse)
+            : juce::Thread ("SimpleEQ Convolution Worker"), owner (ownerToUse)
+        {
+        }
+
+        void run() override
+        {
+            owner.workerRunning.store (true, std::memory_order_release);
+
+            //the audio thread signals once per long period, not once per block
+            while (! threadShouldExit())
+            {
+                if (! owner.runPendingJob (executor))
+                    wait (-1);
+            }
+
+            owner.workerRunning.store (false, std::memory_order_release);
+        }
+
+        NonUniformConvolver& owner;
+        Executor executor;
+    };
+
+    std::vector<ChannelState> channels;
+    std::array<StageState, NonUniformLayout::maxStages> stages;
+    std::array<NonUniformKernel, 2> kernels;
+    int currentKernel = 0;
+
+    int position = 0, headFadeRemaining = 0, transitionRemaining = 0;
+    bool realtime = true, playing = false;
+
+    std::array<float, NonUniformLayout::headLength> chunkOut {}, fadingHead {};
+    Executor audioExecutor;
+    std::atomic<bool> workerRunning { false };
+    Worker worker { *this };
+
+    NonUniformKernel& current() { return kernels[(size_t) currentKernel]; }
+    const NonUniformKernel& current() const { return kernels[(size_t) currentKernel]; }
+
+    template<typename SampleType>
+    void processChunk (SampleType* samples, int numSamples, ChannelState& channel, const NonUniformLayout& layout)
+    {
+        constexpr auto headLength = NonUniformLayout::headLength;
+        auto& history = channel.history;
+
+        for (int i = 0; i < numSamples; ++i)
+            history[(size_t) (headLength - 1 + i)] = (float) samples[i];
+
+        convolveHead (history.data(), current().getReversedHead(), chunkOut.data(), numSamples);
+
+        if (headFadeRemaining > 0)
+        {
+            convolveHead (history.data(), kernels[(size_t) (currentKernel ^ 1)].getReversedHead(), fadingHead.data(), numSamples);
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                auto gain = juce::jmin (1.f, (float) (headLength - headFadeRemaining + i + 1) / (float) headLength);
+                chunkOut[(size_t) i] = fadingHead[(size_t) i] + gain * (chunkOut[(size_t) i] - fadingHead[(size_t) i]);
+            }
+        }
+
+        std::copy (history.begin() + numSamples, history.begin() + numSamples + headLength - 1, history.begin());
+
+        for (int s = 0; s < layout.numStages; ++s)
+        {
+            auto& state = channel.stages[(size_t) s];
+            auto partitionLength = layout.stages[(size_t) s].partitionLength;
+            auto phase = stages[(size_t) s].phase;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                state.input[(size_t) (partitionLength + phase + i)] = (float) samples[i];
+                chunkOut[(size_t) i] += state.playing[(size_t) (phase + i)];
+            }
+        }
+
+        for (int i = 0; i < numSamples; ++i)
+            samples[i] = (SampleType) chunkOut[(size_t) i];
+    }
+
+    static void convolveHead (const float* history, const float* reversedHead, float* output, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto sum = 0.f;
+            for (int k = 0; k < NonUniformLayout::headLength; ++k)
+                sum += reversedHead[k] * history[i + k];
+
+            output[i] = sum;
+        }
+    }
+
+    /** A stage has a complete partition of input: play the result that is due, and start on the next. */
+    void finishPeriod (int stageIndex, size_t numChannels)
+    {
+        auto& stage = stages[(size_t) stageIndex];
+        auto delay = current().getLayout().stages[(size_t) stageIndex].getOutputDelay();
+
+        if (stage.resyncing && ! finishResync (stageIndex))
+        {
+            playSilence (stageIndex, numChannels);
+            shiftInput (stageIndex, numChannels);
+            return;
+        }
+
+        //the job launched delay periods ago holds the output for the period starting now
+        if (delay > 0)
+            collectResult (stageIndex, numChannels, stage.launched - (juce::uint32) delay, stage.launched >= (juce::uint32) delay);
+
+        launchJob (stageIndex, numChannels);
+
+        if (delay == 0)
+            collectResult (stageIndex, numChannels, stage.launched - 1, stage.launched > 0);
+    }
+
+    void launchJob (int stageIndex, size_t numChannels)
+    {
+        auto& stage = stages[(size_t) stageIndex];
+        auto slotIndex = (size_t) (stage.launched % numJobSlots);
+        auto& slot = stage.slots[slotIndex];
+        auto state = slot.state.load (std::memory_order_acquire);
+
+        //the worker is a whole period behind: start the stage over, rather than wait for it
+        if (state == pending || state == running)
+        {
+            beginResync (stageIndex);
+            shiftInput (stageIndex, numChannels);
+            return;
+        }
+
+        for (size_t ch = 0; ch < numChannels; ++ch)
+        {
+            auto& channelStage = channels[ch].stages[(size_t) stageIndex];
+            std::copy (channelStage.input.begin(), channelStage.input.end(), channelStage.slots[slotIndex].input.begin());
+        }
+
+        shiftInput (stageIndex, numChannels);
+
+        slot.sequence = stage.launched++;
+        slot.kernel = currentKernel;
+        slot.fades = stage.fadePending;
+        slot.numChannels = numChannels;
+        stage.fadePending = false;
+        slot.state.store (pending, std::memory_order_release);
+
+        auto offloaded = current().getLayout().stages[(size_t) stageIndex].isOffloaded();
+
+        if (realtime && offloaded && workerRunning.load (std::memory_order_acquire))
+            worker.notify();
+        else
+            runJobsInOrder (stageIndex);
+    }
+
+    /** Moves the result of the given job into play, or silence if it is not ready. */
+    void collectResult (int stageIndex, size_t numChannels, juce::uint32 sequence, bool wasLaunched)
+    {
+        auto& slot = stages[(size_t) stageIndex].slots[(size_t) (sequence % numJobSlots)];
+
+        if (! wasLaunched || slot.sequence != sequence || slot.state.load (std::memory_order_acquire) != done)
+        {
+            playSilence (stageIndex, numChannels);
+            return;
+        }
+
+        for (size_t ch = 0; ch < numChannels; ++ch)
+        {
+            auto& channelStage = channels[ch].stages[(size_t) stageIndex];
+            auto& result = channelStage.slots[(size_t) (sequence % numJobSlots)].result;
+
+            if (ch < slot.numChannels)
+                std::swap (result, channelStage.playing);
+            else
+                std::fill (channelStage.playing.begin(), channelStage.playing.end(), 0.f);
+        }
+
+        slot.state.store (idle, std::memory_order_relaxed);
+    }
+
+    void playSilence (int stageIndex, size_t numChannels)
+    {
+        for (size_t ch = 0; ch < numChannels; ++ch)
+        {
+            auto& playing = channels[ch].stages[(size_t) stageIndex].playing;
+            std::fill (playing.begin(), playing.end(), 0.f);
+        }
+    }
+
+    void shiftInput (int stageIndex, size_t numChannels)
+    {
+        auto partitionLength = current().getLayout().stages[(size_t) stageIndex].partitionLength;
+
+        for (size_t ch = 0; ch < numChannels; ++ch)
+        {
+            auto& input = channels[ch].stages[(size_t) stageIndex].input;
+            std::copy (input.begin() + partitionLength, input.end(), input.begin());
+        }
+    }
+
+    /** Runs the stage's launched jobs on the audio thread, up to one the worker is holding. */
+    void runJobsInOrder (int stageIndex)
+    {
+        auto& stage = stages[(size_t) stageIndex];
+
+        for (;;)
+        {
+            auto next = stage.completed.load (std::memory_order_acquire);
+            if (next == stage.launched)
+                return;
+
+            if (! runJob (stageIndex, next, audioExecutor))
+            {
+                //its result will be late; only an offline render can afford to wait for it
+                if (realtime)
+                    return;
+
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    /** Claims and computes the given job if it is pending. Returns false if there was nothing to claim. */
+    bool runJob (int stageIndex, juce::uint32 sequence, Executor& executor)
+    {
+        auto& stage = stages[(size_t) stageIndex];
+        auto& slot = stage.slots[(size_t) (sequence % numJobSlots)];
+
+        auto expected = (int) pending;
+        if (! slot.state.compare_exchange_strong (expected, running, std::memory_order_acq_rel))
+            return false;
+
+        //a stage that started over since sequence was read has renumbered its jobs
+        if (slot.sequence != stage.completed.load (std::memory_order_acquire))
+        {
+            slot.state.store (pending, std::memory_order_release);
+            return false;
+        }
+
+        computeJob (stageIndex, (size_t) (sequence % numJobSlots), executor);
+        return true;
+    }
+
+    void computeJob (int stageIndex, size_t slotIndex, Executor& executor)
+    {
+        auto& stage = stages[(size_t) stageIndex];
+        auto& slot = stage.slots[slotIndex];
+
+        const auto& kernel = kernels[(size_t) slot.kernel].getStageKernel (stageIndex);
+        const auto& fadingKernel = kernels[(size_t) (slot.kernel ^ 1)].getStageKernel (stageIndex);
+        auto partitionLength = kernel.getPartitionLength();
+
+        for (size_t ch = 0; ch < slot.numChannels; ++ch)
+        {
+            auto& state = channels[ch].stages[(size_t) stageIndex];
+            auto& channelSlot = state.slots[slotIndex];
+            state.delayLine.push (channelSlot.input.data(), kernel, executor.transforms);
+
+            if (slot.fades)
+            {
+                auto* faded = state.delayLine.convolve (fadingKernel, executor.transforms);
+                std::copy (faded, faded + partitionLength, executor.fadingOut.begin());
+            }
+
+            auto* result = state.delayLine.convolve (kernel, executor.transforms);
+
+            if (slot.fades)
+                crossfadeBlocks (channelSlot.result.data(), executor.fadingOut.data(), result, partitionLength);
+            else
+                std::copy (result, result + partitionLength, channelSlot.result.begin());
+        }
+
+        slot.state.store (done, std::memory_order_release);
+        stage.completed.fetch_add (1, std::memory_order_acq_rel);
+    }
+
+    /** Called by the worker: runs the most urgent pending job, shortest partitions first. */
+    bool runPendingJob (Executor& executor)
+    {
+        for (int i = 0; i < NonUniformLayout::maxStages; ++i)
+        {
+            if (runJob (i, stages[(size_t) i].completed.load (std::memory_order_acquire), executor))
+                return true;
+        }
+
+        return false;
+    }
+
+    bool hasJobsInFlight() const
+    {
+        for (const auto& stage : stages)
+        {
+            for (const auto& slot : stage.slots)
+            {
+                auto state = slot.state.load (std::memory_order_acquire);
+                if (state == pending || state == running)
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    /** Drops the stage's jobs nobody has started, and clears it as soon as the worker is not running one. */
+    void beginResync (int stageIndex)
+    {
+        auto& stage = stages[(size_t) stageIndex];
+        stage.resyncing = true;
+
+        for (auto& slot : stage.slots)
+        {
+            auto expected = (int) pending;
+            slot.state.compare_exchange_strong (expected, idle, std::memory_order_acq_rel);
+        }
+
+        finishResync (stageIndex);
+    }
+
+    bool finishResync (int stageIndex)
+    {
+        auto& stage = stages[(size_t) stageIndex];
+
+        for (auto& slot : stage.slots)
+        {
+            while (slot.state.load (std::memory_order_acquire) == running)
+            {
+                if (realtime)
+                    return false;
+
+                std::this_thread::yield();
+            }
+        }
+
+        //nothing is pending or running, so the worker will not touch the stage until it launches again
+        for (auto& channel : channels)
+            channel.stages[(size_t) stageIndex].delayLine.clear();
+
+        for (auto& slot : stage.slots)
+            slot.state.store (idle, std::memory_order_relaxed);
+
+        stage.launched = 0;
+        stage.completed.store (0, std::memory_order_release);
+        stage.resyncing = false;
+        return true;
+    }
+};
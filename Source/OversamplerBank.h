@@ -0,0 +1,107 @@
+/*
+  ==============================================================================
+
+    The 2x, 4x and 8x oversamplers the filter chain can run inside.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+enum OversamplingOrder
+{
+    Oversampling_Off,
+    Oversampling_2x,
+    Oversampling_4x,
+    Oversampling_8x
+};
+
+/**
+ Holds one juce::dsp::Oversampling per factor, all built in prepare(), so
+ switching factor on the audio thread never allocates. They use the
+ polyphase IIR half-band filters: a couple of allpass sections per channel
+ and stage, far cheaper than the equiripple FIR ones.
+ */
+template<typename SampleType>
+class OversamplerBank
+{
+public:
+    using Oversampler = juce::dsp::Oversampling<SampleType>;
+
+    void prepare (size_t numChannels, size_t maximumBlockSize)
+    {
+        blockSize = juce::jmax (maximumBlockSize, (size_t) 1);
+
+        for (size_t i = 0; i < oversamplers.size(); ++i)
+        {
+            //integer latency, so the host can compensate it exactly
+            oversamplers[i] = std::make_unique<Oversampler> (numChannels, i + 1,
+                                                             Oversampler::filterHalfBandPolyphaseIIR,
+                                                             true, true);
+            oversamplers[i]->initProcessing (blockSize);
+        }
+    }
+
+    void release()
+    {
+        for (auto& oversampler : oversamplers)
+            oversampler.reset();
+    }
+
+    bool isPrepared() const { return oversamplers.front() != nullptr; }
+
+    void reset (OversamplingOrder order)
+    {
+        if (auto* oversampler = get (order))
+            oversampler->reset();
+    }
+
+    int getLatencyInSamples (OversamplingOrder order) const
+    {
+        if (auto* oversampler = get (order))
+            return juce::roundToInt (oversampler->getLatencyInSamples());
+
+        return 0;
+    }
+
+    /**
+     Upsamples the block by the given order, hands the oversampled block to
+     processAtHigherRate, then downsamples back in place. Blocks longer than
+     the prepared size are split.
+     */
+    template<typename ProcessFunction>
+    void process (const juce::dsp::AudioBlock<SampleType>& block, OversamplingOrder order,
+                  ProcessFunction&& processAtHigherRate)
+    {
+        auto* oversampler = get (order);
+
+        if (oversampler == nullptr)
+        {
+            processAtHigherRate (block);
+            return;
+        }
+
+        auto numSamples = block.getNumSamples();
+        for (size_t start = 0; start < numSamples; start += blockSize)
+        {
+            auto subBlock = block.getSubBlock (start, juce::jmin (blockSize, numSamples - start));
+
+            auto upsampled = oversampler->processSamplesUp (subBlock);
+            processAtHigherRate (upsampled);
+            oversampler->processSamplesDown (subBlock);
+        }
+    }
+private:
+    std::array<std::unique_ptr<Oversampler>, Oversampling_8x> oversamplers;
+    size_t blockSize = 1;
+
+    Oversampler* get (OversamplingOrder order) const
+    {
+        if (order == Oversampling_Off)
+            return nullptr;
+
+        return oversamplers[(size_t) order - 1].get();
+    }
+};
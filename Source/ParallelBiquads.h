@@ -0,0 +1,439 @@
+/*
+  ==============================================================================
+
+    The chain realised in parallel form: its transfer function split by
+    partial fractions into sections that all take the same input and whose
+    outputs are summed, plus a short FIR for whatever the numerator has left
+    over. No section waits on another, so one channel can fill every lane of
+    a register.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <optional>
+#include "FilterCoefficients.h"
+
+//the FIR part has a tap for every order the chain's numerator exceeds its denominator by, and one more
+static constexpr int maxParallelFirLength = 2 * maxChainSections + 1;
+
+template<typename NumericType>
+struct ParallelCoefficients
+{
+    //each section is c0 + c1 z^-1 (b0 and b1, with b2 zero) over one of the cascade's denominators
+    std::array<BiquadCoefficients<NumericType>, maxChainSections> sections;
+
+    //the slot of the cascade section whose poles each section has, which its state follows
+    std::array<int, maxChainSections> slots {};
+    int numSections = 0;
+
+    std::array<NumericType, maxParallelFirLength> fir {};
+    int firLength = 0;
+};
+
+/**
+ Expands the chain into parallel form. Each section keeps the denominator of
+ the cascade section it came from, so every pole stays exactly where it was
+ designed, and only the numerators are solved for. They come from the poles
+ themselves, as the chain's response with that section's denominator taken
+ out, which needs no polynomial to be multiplied out or divided.
+
+ Returns false if two poles coincide, as every Linkwitz-Riley cut's do, or if
+ the sections would mostly cancel one another. Their rounding errors add up
+ with the sum of their impulse responses' absolute values, which
+ maxConditionNumber bounds for an input of unit amplitude.
+ */
+template<typename NumericType>
+bool expandIntoParallelForm (const ChainCoefficients<NumericType>& chain,
+                             ParallelCoefficients<NumericType>& parallel,
+                             double maxConditionNumber)
+{
+    using Complex = std::complex<double>;
+
+    std::array<BiquadCoefficients<double>, maxChainSections> cascade;
+    std::array<int, maxChainSections> slots {};
+    int numCascadeSections = 0, numeratorOrder = 0, denominatorOrder = 0;
+
+    forEachActiveSection (chain, [&] (int slot, const BiquadCoefficients<NumericType>& c)
+    {
+        cascade[(size_t) numCascadeSections] = { (double) c.b0, (double) c.b1, (double) c.b2, (double) c.a1, (double) c.a2 };
+        slots[(size_t) numCascadeSections++] = slot;
+
+        numeratorOrder += c.b2 != 0 ? 2 : (c.b1 != 0 ? 1 : 0);
+        denominatorOrder += c.a2 != 0 ? 2 : (c.a1 != 0 ? 1 : 0);
+    });
+
+    //with x = z^-1, the chain's response less section k's denominator
+    auto getResidueNumerator = [&] (int k, Complex x)
+    {
+        const auto& c = cascade[(size_t) k];
+        auto value = c.b0 + x * (c.b1 + x * c.b2);
+
+        for (int j = 0; j < numCascadeSections; ++j)
+        {
+            if (j == k)
+                continue;
+
+            const auto& other = cascade[(size_t) j];
+            value *= (other.b0 + x * (other.b1 + x * other.b2)) / (1.0 + x * (other.a1 + x * other.a2));
+        }
+
+        return value;
+    };
+
+    std::array<BiquadCoefficients<double>, maxChainSections> sections;
+    int numSections = 0;
+    auto conditionNumber = 0.0;
+
+    for (int k = 0; k < numCascadeSections; ++k)
+    {
+        const auto& c = cascade[(size_t) k];
+
+        //a section without poles only adds to the numerator
+        if (c.a1 == 0 && c.a2 == 0)
+            continue;
+
+        if (c.a2 == 0)
+        {
+            //one real pole, and a residue that is just a gain
+            auto pole = -c.a1;
+            if (std::abs (pole) >= 1)
+                return false;
+
+            auto residue = getResidueNumerator (k, 1.0 / pole);
+            conditionNumber += std::abs (residue) / (1 - std::abs (pole));
+            sections[(size_t) numSections] = { residue.real(), 0, 0, c.a1, 0 };
+        }
+        else
+        {
+            //the roots of z^2 + a1 z + a2, the smaller one from the product so it loses no precision
+            auto root = std::sqrt (Complex (c.a1 * c.a1 - 4 * c.a2));
+            auto p = -0.5 * (c.a1 + (c.a1 < 0 ? -root : root));
+            auto q = c.a2 / p;
+
+            if (std::abs (p) >= 1 || std::abs (q) >= 1)
+                return false;
+
+            //c0 + c1 x has to match the residue numerator at both poles
+            auto u = getResidueNumerator (k, 1.0 / p);
+            auto v = getResidueNumerator (k, 1.0 / q);
+            auto c1 = (u - v) / (1.0 / p - 1.0 / q);
+            auto c0 = u - c1 / p;
+
+            //the same numerator as a residue per pole, whose impulse response decays as |pole|^n
+            conditionNumber += std::abs (u / (1.0 - q / p)) / (1 - std::abs (p))
+                             + std::abs (v / (1.0 - p / q)) / (1 - std::abs (q));
+
+            sections[(size_t) numSections] = { c0.real(), c1.real(), 0, c.a1, c.a2 };
+        }
+
+        slots[(size_t) numSections++] = slots[(size_t) k];
+    }
+
+    //whatever the sections miss of the first few samples of the impulse response is the FIR part
+    auto firLength = numeratorOrder >= denominatorOrder ? numeratorOrder - denominatorOrder + 1 : 0;
+    std::array<double, maxParallelFirLength> fir {};
+
+    auto runImpulse = [firLength] (const BiquadCoefficients<double>& c, std::array<double, maxParallelFirLength>& signal)
+    {
+        double s1 = 0, s2 = 0;
+        for (int i = 0; i < firLength; ++i)
+        {
+            auto input = signal[(size_t) i];
+            auto output = input * c.b0 + s1;
+            s1 = (input * c.b1) - (output * c.a1) + s2;
+            s2 = (input * c.b2) - (output * c.a2);
+            signal[(size_t) i] = output;
+        }
+    };
+
+    if (firLength > 0)
+    {
+        fir[0] = 1;
+        for (int k = 0; k < numCascadeSections; ++k)
+            runImpulse (cascade[(size_t) k], fir);
+
+        for (int k = 0; k < numSections; ++k)
+        {
+            std::array<double, maxParallelFirLength> response {};
+            response[0] = 1;
+            runImpulse (sections[(size_t) k], response);
+
+            for (int i = 0; i < firLength; ++i)
+                fir[(size_t) i] -= response[(size_t) i];
+        }
+
+        for (int i = 0; i < firLength; ++i)
+            conditionNumber += std::abs (fir[(size_t) i]);
+    }
+
+    //coincident poles leave a residue of infinity, or of 0 / 0
+    if (! std::isfinite (conditionNumber) || conditionNumber > maxConditionNumber)
+        return false;
+
+    for (int k = 0; k < numSections; ++k)
+    {
+        const auto& c = sections[(size_t) k];
+        parallel.sections[(size_t) k] = { (NumericType) c.b0, (NumericType) c.b1, 0, (NumericType) c.a1, (NumericType) c.a2 };
+        parallel.slots[(size_t) k] = slots[(size_t) k];
+    }
+
+    for (int i = 0; i < firLength; ++i)
+        parallel.fir[(size_t) i] = (NumericType) fir[(size_t) i];
+
+    parallel.numSections = numSections;
+    parallel.firLength = firLength;
+    return true;
+}
+
+/** A register's worth of parallel sections; a2 is kept negated, so the feedback into s2 is one multiply. */
+template<typename Register>
+struct ParallelSectionGroup
+{
+    Register c0, c1, a1, negativeA2;
+};
+
+template<typename Register>
+struct ParallelSectionState
+{
+    Register s1, s2;
+};
+
+/**
+ Runs NumGroups registers of parallel sections on one channel: every lane of
+ every register takes the same input, and the outputs of all of them are
+ summed, together with the FIR part's first tap. Each section is transposed
+ direct form II, as in the cascade.
+ */
+template<int NumGroups, typename SampleType>
+void processParallel (SampleType* samples,
+                      size_t numSamples,
+                      const ParallelSectionGroup<juce::dsp::SIMDRegister<SampleType>>* groups,
+                      ParallelSectionState<juce::dsp::SIMDRegister<SampleType>>* states,
+                      SampleType direct)
+{
+    using Register = juce::dsp::SIMDRegister<SampleType>;
+
+    if constexpr (NumGroups > 0)
+    {
+        Register s1[NumGroups], s2[NumGroups];
+        for (int k = 0; k < NumGroups; ++k)
+        {
+            s1[k] = states[k].s1;
+            s2[k] = states[k].s2;
+        }
+
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            auto input = Register::expand (samples[i]);
+            auto sum = Register::expand (0);
+
+            for (int k = 0; k < NumGroups; ++k)
+            {
+                const auto& c = groups[k];
+                auto output = input * c.c0 + s1[k];
+                s1[k] = (input * c.c1) - (output * c.a1) + s2[k];
+                s2[k] = output * c.negativeA2;
+                sum += output;
+            }
+
+            samples[i] = sum.sum() + samples[i] * direct;
+        }
+
+        //as snapToZero(), lane by lane
+        alignas (Register::SIMDRegisterSize) SampleType lanes[Register::SIMDNumElements];
+        auto snap = [&lanes] (Register& value)
+        {
+            value.copyToRawArray (lanes);
+            for (auto& lane : lanes)
+                if (! (lane < -1.0e-8f || lane > 1.0e-8f))
+                    lane = 0;
+
+            value = Register::fromRawArray (lanes);
+        };
+
+        for (int k = 0; k < NumGroups; ++k)
+        {
+            snap (s1[k]);
+            snap (s2[k]);
+            states[k] = { s1[k], s2[k] };
+        }
+    }
+    else
+    {
+        juce::ignoreUnused (groups, states);
+
+        for (size_t i = 0; i < numSamples; ++i)
+            samples[i] *= direct;
+    }
+}
+
+template<typename SampleType>
+using ParallelKernel = void (*) (SampleType*, size_t,
+                                 const ParallelSectionGroup<juce::dsp::SIMDRegister<SampleType>>*,
+                                 ParallelSectionState<juce::dsp::SIMDRegister<SampleType>>*,
+                                 SampleType);
+
+template<typename SampleType, size_t... GroupCounts>
+constexpr auto makeParallelKernels (std::index_sequence<GroupCounts...>)
+{
+    return std::array<ParallelKernel<SampleType>, sizeof... (GroupCounts)> { &processParallel<(int) GroupCounts, SampleType>... };
+}
+
+/**
+ One channel's chain run in parallel form, a register's worth of sections at
+ a time. setCoefficients() takes a design getParallelForm() has already
+ expanded, as that is too slow for the audio thread.
+ */
+template<typename SampleType>
+class ParallelBiquadChain
+{
+public:
+    using Register = juce::dsp::SIMDRegister<SampleType>;
+    static constexpr size_t numLanes = Register::SIMDNumElements;
+    static constexpr int maxGroups = (maxChainSections + (int) numLanes - 1) / (int) numLanes;
+
+    /**
+     The largest condition number accepted: for float about 1e3, which keeps
+     the sum's rounding error near -80 dB at worst; for double, far more.
+     */
+    static constexpr double maxConditionNumber = std::is_same_v<SampleType, float> ? 1.0e3 : 1.0e9;
+
+    void prepare (size_t maximumBlockSize)
+    {
+        firScratch.resize (juce::jmax (maximumBlockSize, (size_t) 1));
+        reset();
+    }
+
+    void reset()
+    {
+        states.fill ({ Register::expand (0), Register::expand (0) });
+        history.fill (0);
+    }
+
+    /** Takes a new design, keeping the state of every section whose poles stay in the same slot. */
+    void setCoefficients (const ParallelCoefficients<SampleType>& expanded)
+    {
+        relayout (expanded);
+        coefficients = expanded;
+
+        //idle lanes hold a section with no input and no feedback, which outputs nothing
+        alignas (Register::SIMDRegisterSize) SampleType c0[numLanes], c1[numLanes], a1[numLanes], negativeA2[numLanes];
+        auto numGroups = getNumGroups();
+
+        for (int group = 0; group < numGroups; ++group)
+        {
+            for (size_t lane = 0; lane < numLanes; ++lane)
+            {
+                auto index = group * (int) numLanes + (int) lane;
+                BiquadCoefficients<SampleType> c { 0, 0, 0, 0, 0 };
+                if (index < coefficients.numSections)
+                    c = coefficients.sections[(size_t) index];
+
+                c0[lane] = c.b0, c1[lane] = c.b1, a1[lane] = c.a1, negativeA2[lane] = -c.a2;
+            }
+
+            groups[(size_t) group] = { Register::fromRawArray (c0), Register::fromRawArray (c1),
+                                       Register::fromRawArray (a1), Register::fromRawArray (negativeA2) };
+        }
+
+        static constexpr auto kernels = makeParallelKernels<SampleType> (std::make_index_sequence<maxGroups + 1>());
+        kernel = kernels[(size_t) numGroups];
+    }
+
+    void process (SampleType* samples, size_t numSamples)
+    {
+        auto direct = coefficients.firLength > 0 ? coefficients.fir[0] : (SampleType) 0;
+
+        //a chain whose numerator outgrows its denominator has FIR taps past the first; most have none
+        if (coefficients.firLength <= 1)
+        {
+            kernel (samples, numSamples, groups.data(), states.data(), direct);
+            return;
+        }
+
+        for (size_t start = 0; start < numSamples; start += firScratch.size())
+        {
+            auto* chunk = samples + start;
+            auto chunkSize = juce::jmin (firScratch.size(), numSamples - start);
+
+            processFirTail (chunk, chunkSize);
+            kernel (chunk, chunkSize, groups.data(), states.data(), direct);
+
+            for (size_t i = 0; i < chunkSize; ++i)
+                chunk[i] += firScratch[i];
+        }
+    }
+private:
+    ParallelCoefficients<SampleType> coefficients;
+    std::array<ParallelSectionGroup<Register>, maxGroups> groups;
+    std::array<ParallelSectionState<Register>, maxGroups> states;
+    ParallelKernel<SampleType> kernel = &processParallel<0, SampleType>;
+
+    //the inputs before the current chunk, newest first, for the FIR taps past the first
+    std::array<SampleType, maxParallelFirLength> history {};
+    std::vector<SampleType> firScratch;
+
+    int getNumGroups() const { return (coefficients.numSections + (int) numLanes - 1) / (int) numLanes; }
+
+    void processFirTail (const SampleType* input, size_t numSamples)
+    {
+        const auto firLength = (size_t) coefficients.firLength;
+
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            SampleType sum = 0;
+            for (size_t tap = 1; tap < firLength; ++tap)
+                sum += coefficients.fir[tap] * (tap <= i ? input[i - tap] : history[tap - i - 1]);
+
+            firScratch[i] = sum;
+        }
+
+        //shift the newest inputs in
+        auto numKept = juce::jmin (numSamples, firLength - 1);
+        std::copy_backward (history.begin(), history.begin() + (firLength - 1 - numKept), history.begin() + (firLength - 1));
+        for (size_t i = 0; i < numKept; ++i)
+            history[i] = input[numSamples - 1 - i];
+    }
+
+    /** Moves each section's state to wherever a section with its slot lands in the new design. */
+    void relayout (const ParallelCoefficients<SampleType>& to)
+    {
+        alignas (Register::SIMDRegisterSize) SampleType s1[maxGroups * numLanes] = {}, s2[maxGroups * numLanes] = {};
+        for (int group = 0; group < maxGroups; ++group)
+        {
+            states[(size_t) group].s1.copyToRawArray (s1 + group * (int) numLanes);
+            states[(size_t) group].s2.copyToRawArray (s2 + group * (int) numLanes);
+        }
+
+        alignas (Register::SIMDRegisterSize) SampleType newS1[maxGroups * numLanes] = {}, newS2[maxGroups * numLanes] = {};
+        auto fromSlots = coefficients.slots.begin(), fromEnd = fromSlots + coefficients.numSections;
+
+        for (int i = 0; i < to.numSections; ++i)
+        {
+            auto found = std::find (fromSlots, fromEnd, to.slots[(size_t) i]);
+            if (found != fromEnd)
+            {
+                newS1[i] = s1[found - fromSlots];
+                newS2[i] = s2[found - fromSlots];
+            }
+        }
+
+        for (int group = 0; group < maxGroups; ++group)
+            states[(size_t) group] = { Register::fromRawArray (newS1 + group * (int) numLanes),
+                                       Register::fromRawArray (newS2 + group * (int) numLanes) };
+    }
+};
+
+/** Returns the chain expanded into parallel form, or nothing where it does not expand accurately enough for SampleType. */
+template<typename SampleType>
+std::optional<ParallelCoefficients<SampleType>> getParallelForm (const ChainCoefficients<SampleType>& chain)
+{
+    ParallelCoefficients<SampleType> parallel;
+    if (! expandIntoParallelForm (chain, parallel, ParallelBiquadChain<SampleType>::maxConditionNumber))
+        return {};
+
+    return parallel;
+}
@@ -0,0 +1,415 @@
+/*
+  ==============================================================================
+
+    Partitioned overlap-save convolution, used to run the chain's response
+    as a long FIR.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+enum PartitionSize
+{
+    Partition_64,
+    Partition_128,
+    Partition_256,
+    Partition_512,
+    Partition_1024
+};
+
+inline int getPartitionLength (PartitionSize size) { return 64 << size; }
+
+//the range of partition lengths any convolver here transforms
+static constexpr int minPartitionLength = 64;
+static constexpr int maxPartitionLength = 4096;
+
+/**
+ One real FFT per power of two partition length, each twice the partition
+ length, plus scratch space for a transform. Construction allocates;
+ transforming does not. Each thread that transforms partitions needs its
+ own instance.
+ */
+class PartitionTransforms
+{
+public:
+    PartitionTransforms()
+    {
+        //a partition of minPartitionLength needs an FFT of order 7
+        for (size_t i = 0; i < ffts.size(); ++i)
+            ffts[i] = std::make_unique<juce::dsp::FFT> (7 + (int) i);
+
+        //the real-only transforms work in place on twice the FFT size
+        scratch.resize ((size_t) (4 * maxPartitionLength));
+    }
+
+    /**
+     Zero-pads the first numSamples of source to twice the partition length
+     and returns its spectrum: partitionLength + 1 interleaved complex bins.
+     */
+    const float* forward (int partitionLength, const float* source, int numSamples)
+    {
+        auto fftSize = 2 * partitionLength;
+        jassert (numSamples <= fftSize);
+
+        std::fill (std::copy (source, source + numSamples, scratch.begin()), scratch.begin() + 2 * fftSize, 0.f);
+        getFft (partitionLength).performRealOnlyForwardTransform (scratch.data(), true);
+        return scratch.data();
+    }
+
+    /** Returns the time signal of the spectrum held in getScratch(); the transform is scaled by 1 / fftSize. */
+    const float* inverse (int partitionLength)
+    {
+        getFft (partitionLength).performRealOnlyInverseTransform (scratch.data());
+        return scratch.data();
+    }
+
+    float* getScratch() { return scratch.data(); }
+private:
+    std::array<std::unique_ptr<juce::dsp::FFT>, 7> ffts;
+    std::vector<float> scratch;
+
+    juce::dsp::FFT& getFft (int partitionLength)
+    {
+        jassert (juce::isPowerOfTwo (partitionLength) && partitionLength >= minPartitionLength && partitionLength <= maxPartitionLength);
+
+        size_t index = 0;
+        while ((minPartitionLength << index) < partitionLength)
+            ++index;
+
+        return *ffts[index];
+    }
+};
+
+/** Adds the bin-by-bin product of two interleaved complex spectra to accumulator. */
+inline void multiplyAccumulateSpectra (float* accumulator, const float* a, const float* b, int numBins)
+{
+    //written out on interleaved floats, so it vectorises without fast-math
+    for (int i = 0; i < numBins; ++i)
+    {
+        auto re = a[2 * i] * b[2 * i] - a[2 * i + 1] * b[2 * i + 1];
+        auto im = a[2 * i] * b[2 * i + 1] + a[2 * i + 1] * b[2 * i];
+        accumulator[2 * i] += re;
+        accumulator[2 * i + 1] += im;
+    }
+}
+
+/**
+ Writes a linear fade from one block to another, with the second's gain going
+ from startGain to endGain, reached on the last sample. The defaults fade all
+ the way within the block.
+ */
+inline void crossfadeBlocks (float* dest, const float* from, const float* to, int numSamples,
+                             float startGain = 0.f, float endGain = 1.f)
+{
+    auto step = (endGain - startGain) / (float) numSamples;
+    for (int i = 0; i < numSamples; ++i)
+        dest[i] = from[i] + (startGain + (float) (i + 1) * step) * (to[i] - from[i]);
+}
+
+/**
+ An FIR split into equal partitions, each stored as the spectrum of the
+ partition zero-padded to twice its length. Storage is sized once in
+ prepare() for the largest layout the kernel may take, so designing into it
+ never allocates.
+ */
+class PartitionedKernel
+{
+public:
+    static int getNumPartitions (int length, int partitionLength)
+    {
+        return (length + partitionLength - 1) / partitionLength;
+    }
+
+    static int getNumFloats (int length, int partitionLength)
+    {
+        return getNumPartitions (length, partitionLength) * 2 * (partitionLength + 1);
+    }
+
+    /** Sizes the kernel for any length up to maximumLength, in partitions of at least smallestPartitionLength. */
+    void prepare (int maximumLength, int smallestPartitionLength)
+    {
+        int numFloats = 0;
+        for (auto partitionLength = smallestPartitionLength; partitionLength <= maxPartitionLength; partitionLength *= 2)
+            numFloats = juce::jmax (numFloats, getNumFloats (maximumLength, partitionLength));
+
+        spectra.resize ((size_t) numFloats);
+        maxLength = maximumLength;
+        length = 0;
+    }
+
+    void design (const float* impulse, int impulseLength, int newPartitionLength, PartitionTransforms& transforms)
+    {
+        jassert (impulseLength <= maxLength);
+
+        partitionLength = newPartitionLength;
+        length = impulseLength;
+
+        for (int partition = 0; partition < getNumPartitions(); ++partition)
+        {
+            auto start = partition * partitionLength;
+            auto* spectrum = transforms.forward (partitionLength, impulse + start, juce::jmin (partitionLength, length - start));
+            std::copy (spectrum, spectrum + getFloatsPerPartition(), getPartition (partition));
+        }
+    }
+
+    void copyFrom (const PartitionedKernel& other)
+    {
+        jassert (other.length <= maxLength);
+
+        partitionLength = other.partitionLength;
+        length = other.length;
+        std::copy (other.spectra.begin(), other.spectra.begin() + getNumFloats (length, partitionLength), spectra.begin());
+    }
+
+    bool isEmpty() const { return length == 0; }
+    bool hasSameLayoutAs (const PartitionedKernel& other) const { return length == other.length && partitionLength == other.partitionLength; }
+
+    int getLength() const { return length; }
+    int getPartitionLength() const { return partitionLength; }
+    int getNumPartitions() const { return getNumPartitions (length, partitionLength); }
+    int getFloatsPerPartition() const { return 2 * (partitionLength + 1); }
+
+    float* getPartition (int index) { return spectra.data() + index * getFloatsPerPartition(); }
+    const float* getPartition (int index) const { return spectra.data() + index * getFloatsPerPartition(); }
+private:
+    std::vector<float> spectra;
+    int partitionLength = minPartitionLength;
+    int length = 0, maxLength = 0;
+};
+
+/**
+ One channel's recent input partitions, kept as spectra with the newest at
+ the head. Convolving pairs partition k of a kernel with the input from k
+ partitions ago, so each new partition of input costs one forward and one
+ inverse FFT however long the kernel is.
+ */
+class SpectrumDelayLine
+{
+public:
+    void prepare (int maximumFloats)
+    {
+        slots.resize ((size_t) maximumFloats);
+        clear();
+    }
+
+    void clear()
+    {
+        std::fill (slots.begin(), slots.end(), 0.f);
+        head = 0;
+    }
+
+    /** Transforms the last two partitions of input, laid out for kernel, and pushes the spectrum in. */
+    void push (const float* input, const PartitionedKernel& kernel, PartitionTransforms& transforms)
+    {
+        auto partitionLength = kernel.getPartitionLength();
+        auto floatsPerPartition = kernel.getFloatsPerPartition();
+
+        head = (head + 1) % juce::jmax (kernel.getNumPartitions(), 1);
+
+        auto* spectrum = transforms.forward (partitionLength, input, 2 * partitionLength);
+        std::copy (spectrum, spectrum + floatsPerPartition, slots.data() + head * floatsPerPartition);
+    }
+
+    /** Returns the newest partitionLength samples of output; they live in the transform scratch. */
+    const float* convolve (const PartitionedKernel& kernel, PartitionTransforms& transforms) const
+    {
+        auto floatsPerPartition = kernel.getFloatsPerPartition();
+        auto numPartitions = kernel.getNumPartitions();
+        auto* accumulator = transforms.getScratch();
+
+        std::fill (accumulator, accumulator + floatsPerPartition, 0.f);
+
+        for (int partition = 0; partition < numPartitions; ++partition)
+        {
+            auto slot = (head - partition + numPartitions) % numPartitions;
+            multiplyAccumulateSpectra (accumulator,
+                                       slots.data() + slot * floatsPerPartition,
+                                       kernel.getPartition (partition),
+                                       floatsPerPartition / 2);
+        }
+
+        //overlap-save: the first half of the result is wrapped around, the second half is valid
+        return transforms.inverse (kernel.getPartitionLength()) + kernel.getPartitionLength();
+    }
+private:
+    std::vector<float> slots;
+    int head = 0;
+};
+
+/**
+ Runs every channel through one shared partitioned FIR by overlap-save.
+ The output lags the input by one partition.
+
+ A new kernel with the same layout is crossfaded in over fadeSeconds, as
+ many partitions as that takes whatever their size: both kernels are
+ applied to the same delay line and their outputs blended, so even a large
+ change of response does not click.
+ */
+class UniformPartitionedConvolver
+{
+public:
+    void prepare (size_t numChannels, int maximumKernelLength, double sampleRate)
+    {
+        fadeLength = juce::jmax (1, juce::roundToInt (sampleRate * fadeSeconds));
+
+        auto smallestPartitionLength = getPartitionLength (Partition_64);
+        auto largestPartitionLength = getPartitionLength (Partition_1024);
+
+        for (auto& kernel : kernels)
+            kernel.prepare (maximumKernelLength, smallestPartitionLength);
+
+        channels.resize (numChannels);
+        for (auto& channel : channels)
+        {
+            channel.delayLine.prepare (PartitionedKernel::getNumFloats (maximumKernelLength, smallestPartitionLength));
+            channel.input.resize ((size_t) (2 * largestPartitionLength));
+            channel.output.resize ((size_t) largestPartitionLength);
+        }
+
+        fadingOut.resize ((size_t) largestPartitionLength);
+
+        reset();
+    }
+
+    void reset()
+    {
+        for (auto& channel : channels)
+        {
+            channel.delayLine.clear();
+            std::fill (channel.input.begin(), channel.input.end(), 0.f);
+            std::fill (channel.output.begin(), channel.output.end(), 0.f);
+        }
+
+        position = 0;
+        crossfading = false;
+        playing = false;
+    }
+
+    /** False while a kernel change is still being faded in. */
+    bool canAcceptKernel() const { return ! crossfading; }
+
+    /**
+     Copies in a new kernel. If its layout differs from the one in use, or
+     nothing has been processed since a reset, the convolver starts from
+     silence with it; otherwise the old kernel is faded out over the next
+     fadeSeconds.
+     */
+    void setKernel (const PartitionedKernel& kernel)
+    {
+        if (! playing || ! kernel.hasSameLayoutAs (current()))
+        {
+            current().copyFrom (kernel);
+            reset();
+            return;
+        }
+
+        //part way through a fade the output is a blend of both, so a third kernel has to wait its turn
+        jassert (canAcceptKernel());
+
+        currentKernel ^= 1;
+        current().copyFrom (kernel);
+        crossfading = true;
+        fadePosition = 0;
+    }
+
+    int getLatencyInSamples() const { return current().getPartitionLength(); }
+
+    template<typename SampleType>
+    void process (const juce::dsp::AudioBlock<SampleType>& block)
+    {
+        jassert (block.getNumChannels() <= channels.size());
+
+        auto partitionLength = getLatencyInSamples();
+        auto numSamples = (int) block.getNumSamples();
+        playing = true;
+
+        for (int start = 0; start < numSamples;)
+        {
+            auto numToCopy = juce::jmin (numSamples - start, partitionLength - position);
+
+            for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+            {
+                auto* samples = block.getChannelPointer (ch) + start;
+                auto& channel = channels[ch];
+
+                for (int i = 0; i < numToCopy; ++i)
+                {
+                    channel.input[(size_t) (partitionLength + position + i)] = (float) samples[i];
+                    samples[i] = (SampleType) channel.output[(size_t) (position + i)];
+                }
+            }
+
+            position += numToCopy;
+            start += numToCopy;
+
+            if (position == partitionLength)
+            {
+                for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+                    processPartition (channels[ch]);
+
+                if (crossfading)
+                {
+                    fadePosition += partitionLength;
+                    crossfading = fadePosition < fadeLength;
+                }
+
+                position = 0;
+            }
+        }
+    }
+private:
+    struct ChannelState
+    {
+        SpectrumDelayLine delayLine;
+        std::vector<float> input;       //the previous and the current partition of input
+        std::vector<float> output;      //the partition being played out
+    };
+
+    std::vector<ChannelState> channels;
+    std::array<PartitionedKernel, 2> kernels;
+    int currentKernel = 0;
+    bool crossfading = false;
+
+    //false from a reset until the next process(): the old kernel has not been heard, so there is nothing to fade out
+    bool playing = false;
+
+    //long enough to hide a change of the whole 16k-tap response, even at the smallest partition size
+    static constexpr double fadeSeconds = 0.015;
+    int fadeLength = 1, fadePosition = 0;
+
+    PartitionTransforms transforms;
+    std::vector<float> fadingOut;
+    int position = 0;
+
+    PartitionedKernel& current() { return kernels[(size_t) currentKernel]; }
+    const PartitionedKernel& current() const { return kernels[(size_t) currentKernel]; }
+    const PartitionedKernel& previous() const { return kernels[(size_t) (currentKernel ^ 1)]; }
+
+    void processPartition (ChannelState& channel)
+    {
+        auto partitionLength = current().getPartitionLength();
+
+        channel.delayLine.push (channel.input.data(), current(), transforms);
+
+        if (crossfading)
+        {
+            auto* faded = channel.delayLine.convolve (previous(), transforms);
+            std::copy (faded, faded + partitionLength, fadingOut.begin());
+        }
+
+        auto* result = channel.delayLine.convolve (current(), transforms);
+
+        if (crossfading)
+            crossfadeBlocks (channel.output.data(), fadingOut.data(), result, partitionLength,
+                             juce::jmin (1.f, (float) fadePosition / (float) fadeLength),
+                             juce::jmin (1.f, (float) (fadePosition + partitionLength) / (float) fadeLength));
+        else
+            std::copy (result, result + partitionLength, channel.output.begin());
+
+        //the current half becomes the previous half for the next partition
+        std::copy (channel.input.begin() + partitionLength, channel.input.begin() + 2 * partitionLength, channel.input.begin());
+    }
+};
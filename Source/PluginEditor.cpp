@@ -237,9 +237,13 @@ void ResponseCurveComponent::timerCallback()
     leftPathProducer.process (fftBounds, sampleRate);
     rightPathProducer.process (fftBounds, sampleRate);
 
-    if (parametersChanged.compareAndSetBool (false, true))
+    auto settingsVersion = audioProcessor.getChainSettingsVersion();
+
+    if (parametersChanged.compareAndSetBool (false, true) || settingsVersion != drawnSettingsVersion)
     {
-        //update the monochain
+        drawnSettingsVersion = settingsVersion;
+
+        //redesign the chain the curve is drawn from
         updateChain();
     }
 
@@ -248,13 +252,13 @@ void ResponseCurveComponent::timerCallback()
 
 void ResponseCurveComponent::updateChain()
 {
-    auto chainSettings = getChainSettings (audioProcessor.apvts);
-    auto peakCoefficients = makePeakFilter (chainSettings, audioProcessor.getSampleRate());
-    updateCoefficients (monoChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
-    auto lowCutCoefficients = makeLowCutFilter (chainSettings, audioProcessor.getSampleRate());
-    updateCutFilter (monoChain.get<ChainPositions::LowCut>(), lowCutCoefficients, chainSettings.lowCutSlope);
-    auto highCutCoefficients = makeHighCutFilter (chainSettings, audioProcessor.getSampleRate());
-    updateCutFilter (monoChain.get<ChainPositions::HighCut>(), highCutCoefficients, chainSettings.highCutSlope);
+    //draw what the processor actually runs: neutral stages are left out there
+    designChain (responseChain, audioProcessor.getChainSettings(), audioProcessor.getFilterSampleRate());
+
+    auto secondSet = getSecondParameterSet (audioProcessor.getActiveStereoMode());
+    showSecondResponse = secondSet != ParameterSet_Main;
+    if (showSecondResponse)
+        designChain (secondResponseChain, audioProcessor.getChainSettings (secondSet), audioProcessor.getFilterSampleRate());
 }
 
 void ResponseCurveComponent::paint (juce::Graphics& g)
@@ -264,59 +268,50 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
     auto responseArea = getAnalysisArea();
     auto width = responseArea.getWidth();
 
-    auto& lowCut = monoChain.get<ChainPositions::LowCut>();
-    auto& peak = monoChain.get<ChainPositions::Peak>();
-    auto& highCut = monoChain.get<ChainPositions::HighCut>();
+    //the curve is evaluated at the rate the filters actually run at
+    auto sampleRate = audioProcessor.getFilterSampleRate();
 
-    auto sampleRate = audioProcessor.getSampleRate();
-
-    std::vector<double> mags;
-    mags.resize (width);
-    for (int i = 0; i < width; ++i)
-    {
-        double mag = 1.0f;
-        auto freq = mapToLog10 (double (i) / double (width), 20.0, 20000.0);
-
-        if (! monoChain.isBypassed<ChainPositions::Peak>())
-            mag *= peak.coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        
-        if (! lowCut.isBypassed<0>())
-            mag *= lowCut.get<0>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (! lowCut.isBypassed<1>())
-            mag *= lowCut.get<1>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (! lowCut.isBypassed<2>())
-            mag *= lowCut.get<2>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (! lowCut.isBypassed<3>())
-            mag *= lowCut.get<3>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-
-        if (! highCut.isBypassed<0>())
-            mag *= highCut.get<0>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (! highCut.isBypassed<1>())
-            mag *= highCut.get<1>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (! highCut.isBypassed<2>())
-            mag *= highCut.get<2>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (! highCut.isBypassed<3>())
-            mag *= highCut.get<3>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-
-        mags[i] = Decibels::gainToDecibels(mag);
-    }
-
-    Path responseCurve;
     const double outputMin = responseArea.getBottom();
     const double outputMax = responseArea.getY();
     auto map = [outputMin, outputMax] (double input)
     {
         return jmap (input, -24.0, 24.0, outputMin, outputMax);
     };
-    responseCurve.startNewSubPath (responseArea.getX(), map (mags.front()));
-    for (size_t i = 1; i < mags.size(); ++i)
+
+    auto makeResponseCurve = [&] (const ChainCoefficients<double>& chain)
     {
-        responseCurve.lineTo (responseArea.getX() + i, map (mags[i]));
-    }
+        std::vector<double> freqs, mags;
+        freqs.resize (width);
+        mags.resize (width);
+        for (int i = 0; i < width; ++i)
+            freqs[i] = mapToLog10 (double (i) / double (width), 20.0, 20000.0);
+
+        getChainMagnitudes (chain, freqs.data(), width, sampleRate, mags.data());
+
+        for (auto& mag : mags)
+            mag = Decibels::gainToDecibels (mag);
+
+        Path curve;
+        curve.startNewSubPath (responseArea.getX(), map (mags.front()));
+        for (size_t i = 1; i < mags.size(); ++i)
+        {
+            curve.lineTo (responseArea.getX() + i, map (mags[i]));
+        }
+
+        return curve;
+    };
+
+    auto responseCurve = makeResponseCurve (responseChain);
 
     g.fillAll (Colours::black);
     g.drawImage (bg, getLocalBounds().toFloat());
 
+    //which kernels the CPU was dispatched to, so a report of how it sounds says how it ran;
+    //drawn here rather than into bg, since prepareToPlay() can change it at any time
+    g.setColour (Colours::dimgrey);
+    g.setFont (10);
+    g.drawFittedText (audioProcessor.getKernelDescription(), responseArea.reduced (4), juce::Justification::bottomLeft, 1);
+
     auto leftChannelFFTPath = leftPathProducer.getPath();
     leftChannelFFTPath.applyTransform (AffineTransform().translation (responseArea.getX(), responseArea.getY()));
     g.setColour (Colours::red);
@@ -327,6 +322,12 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
     g.setColour (Colours::yellow);
     g.strokePath (rightChannelFFTPath, PathStrokeType (1.0f));
 
+    if (showSecondResponse)
+    {
+        g.setColour (Colours::skyblue);
+        g.strokePath (makeResponseCurve (secondResponseChain), PathStrokeType (2.0f));
+    }
+
     g.setColour (Colours::white);
     g.strokePath (responseCurve, PathStrokeType (2.0f));
 
@@ -457,17 +458,18 @@ juce::Rectangle<int> ResponseCurveComponent::getAnalysisArea()
 //==============================================================================
 SimpleEQAudioProcessorEditor::SimpleEQAudioProcessorEditor (SimpleEQAudioProcessor& p)
     : AudioProcessorEditor (&p), audioProcessor (p),
-      peakFreqSlider (*audioProcessor.apvts.getParameter ("Peak Freq"), "Hz"),
-      peakGainSlider (*audioProcessor.apvts.getParameter ("Peak Gain"), "dB"),
-      peakQualitySlider (*audioProcessor.apvts.getParameter ("Peak Quality"), ""),
+      //the middle knobs edit the first band; the host reaches the others
+      peakFreqSlider (*audioProcessor.apvts.getParameter (getBandParameterID (0, "Freq")), "Hz"),
+      peakGainSlider (*audioProcessor.apvts.getParameter (getBandParameterID (0, "Gain")), "dB"),
+      peakQualitySlider (*audioProcessor.apvts.getParameter (getBandParameterID (0, "Quality")), ""),
       lowCutFreqSlider (*audioProcessor.apvts.getParameter ("LowCut Freq"), "Hz"),
       highCutFreqSlider (*audioProcessor.apvts.getParameter ("HighCut Freq"), "Hz"),
       lowCutSlopeSlider (*audioProcessor.apvts.getParameter ("LowCut Slope"), "dB/oct"),
       highCutSlopeSlider (*audioProcessor.apvts.getParameter ("HighCut Slope"), "dB/oct"),
 
-      peakFreqSliderAttachment (audioProcessor.apvts, "Peak Freq", peakFreqSlider),
-      peakGainSliderAttachment (audioProcessor.apvts, "Peak Gain", peakGainSlider),
-      peakQualitySliderAttachment (audioProcessor.apvts, "Peak Quality", peakQualitySlider),
+      peakFreqSliderAttachment (audioProcessor.apvts, getBandParameterID (0, "Freq"), peakFreqSlider),
+      peakGainSliderAttachment (audioProcessor.apvts, getBandParameterID (0, "Gain"), peakGainSlider),
+      peakQualitySliderAttachment (audioProcessor.apvts, getBandParameterID (0, "Quality"), peakQualitySlider),
       lowCutFreqSliderAttachment (audioProcessor.apvts, "LowCut Freq", lowCutFreqSlider),
       highCutFreqSliderAttachment (audioProcessor.apvts, "HighCut Freq", highCutFreqSlider),
       lowCutSlopeSliderAttachment (audioProcessor.apvts, "LowCut Slope", lowCutSlopeSlider),
@@ -480,7 +482,7 @@ SimpleEQAudioProcessorEditor::SimpleEQAudioProcessorEditor (SimpleEQAudioProcess
     lowCutFreqSlider.labels.add ({0.0f, "20 Hz"});
     lowCutFreqSlider.labels.add ({1.0f, "20 kHz"});
     lowCutSlopeSlider.labels.add ({0.0f, "12"});
-    lowCutSlopeSlider.labels.add ({1.0f, "48"});
+    lowCutSlopeSlider.labels.add ({1.0f, "96"});
     peakFreqSlider.labels.add ({0.0f, "20 Hz"});
     peakFreqSlider.labels.add ({1.0f, "20 kHz"});
     peakGainSlider.labels.add ({0.0f, "-24 dB"});
@@ -490,7 +492,7 @@ SimpleEQAudioProcessorEditor::SimpleEQAudioProcessorEditor (SimpleEQAudioProcess
     highCutFreqSlider.labels.add ({0.0f, "20 Hz"});
     highCutFreqSlider.labels.add ({1.0f, "20 kHz"});
     highCutSlopeSlider.labels.add ({0.0f, "12"});
-    highCutSlopeSlider.labels.add ({1.0f, "48"});
+    highCutSlopeSlider.labels.add ({1.0f, "96"});
 
 
     for (auto* comp : getComps())
@@ -551,4 +553,4 @@ std::vector<juce::Component*> SimpleEQAudioProcessorEditor::getComps()
         &highCutSlopeSlider,
         &responseCurveComponent
     };
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -40,27 +40,9 @@ struct FFTDataGenerator
 
         int numBins = (int)fftSize / 2;
 
-        //normalize the fft values.
-        for (int i = 0; i < numBins; ++i)
-        {
-            auto v = fftData[i];
-//            fftData[i] /= (float) numBins;
-            if (!std::isinf (v) && !std::isnan (v))
-            {
-                v /= float (numBins);
-            }
-            else
-            {
-                v = 0.f;
-            }
-            fftData[i] = v;
-        }
-
-        //convert them to decibels
-        for (int i = 0; i < numBins; ++i)
-        {
-            fftData[i] = juce::Decibels::gainToDecibels (fftData[i], negativeInfinity);
-        }
+        //normalize the fft values and convert them to decibels in one pass;
+        //inf and nan bins come out at negativeInfinity
+        getDispatchedKernels().magnitudesToDecibels (fftData.data(), numBins, 1.f / float (numBins), negativeInfinity);
 
         fftDataFifo.push (fftData);
     }
@@ -220,7 +202,12 @@ struct PathProducer
     {
         leftChannelFFTDataGenerator.changeOrder (FFTOrder::order2048);
         monoBuffer.setSize (1, leftChannelFFTDataGenerator.getFFTSize());
+
+        //the processor only feeds the FIFO while something reads it
+        leftChannelFifo->attachConsumer();
     }
+
+    ~PathProducer() { leftChannelFifo->detachConsumer(); }
     void process (juce::Rectangle<float> fftBounds, double sampleRate);
     juce::Path getPath() { return leftChannelFFTPath; }
 private:
@@ -233,6 +220,8 @@ private:
     AnalyzerPathGenerator<juce::Path> pathProducer;
 
     juce::Path leftChannelFFTPath;
+
+    JUCE_DECLARE_NON_COPYABLE (PathProducer)
 };
 
 struct ResponseCurveComponent : public juce::Component,
@@ -250,7 +239,15 @@ struct ResponseCurveComponent : public juce::Component,
 private:
     SimpleEQAudioProcessor& audioProcessor;
     juce::Atomic<bool> parametersChanged { false };
-    MonoChain monoChain;
+
+    //the processor's snapshot can land a little after the change that flagged it
+    juce::uint32 drawnSettingsVersion = 0;
+    ChainCoefficients<double> responseChain;
+
+    //in Mid/Side and Unlinked the second channel's response is drawn as well
+    ChainCoefficients<double> secondResponseChain;
+    bool showSecondResponse = false;
+
     void updateChain();
     juce::Image bg;
     juce::Rectangle<int> getRenderArea();
@@ -22,10 +22,55 @@ SimpleEQAudioProcessor::SimpleEQAudioProcessor()
                        )
 #endif
 {
+    for (auto set : { ParameterSet_Main, ParameterSet_Side, ParameterSet_Right })
+    {
+        auto ids = [set] (std::initializer_list<const char*> names)
+        {
+            juce::StringArray parameterIDs;
+            for (auto* name : names)
+                parameterIDs.add (getParameterID (set, name));
+
+            return parameterIDs;
+        };
+
+        stageListeners.add (new StageListener (dirtyStages, designer, getLowCutStage (set),
+                                               ids ({ "LowCut Freq", "LowCut Slope", "LowCut Type" })));
+        stageListeners.add (new StageListener (dirtyStages, designer, getHighCutStage (set),
+                                               ids ({ "HighCut Freq", "HighCut Slope", "HighCut Type" })));
+
+        for (int band = 0; band < numBands; ++band)
+        {
+            juce::StringArray parameterIDs;
+            for (auto* name : { "Freq", "Gain", "Quality", "Type", "On" })
+                parameterIDs.add (getParameterID (set, getBandParameterID (band, name)));
+
+            stageListeners.add (new StageListener (dirtyStages, designer, getBandStage (set, band), parameterIDs));
+        }
+    }
+
+    for (auto* listener : stageListeners)
+        for (auto& parameterID : listener->parameterIDs)
+            apvts.addParameterListener (parameterID, listener);
+
+    for (auto& parameterID : CoefficientDesigner::parameterIDs)
+        apvts.addParameterListener (parameterID, &designer);
+
+    //pick the kernels here rather than on the audio thread's first block
+    getDispatchedKernels();
+
+    designer.startThread();
 }
 
 SimpleEQAudioProcessor::~SimpleEQAudioProcessor()
 {
+    designer.stopThread (1000);
+
+    for (auto* listener : stageListeners)
+        for (auto& parameterID : listener->parameterIDs)
+            apvts.removeParameterListener (parameterID, listener);
+
+    for (auto& parameterID : CoefficientDesigner::parameterIDs)
+        apvts.removeParameterListener (parameterID, &designer);
 }
 
 //==============================================================================
@@ -63,7 +108,10 @@ bool SimpleEQAudioProcessor::isMidiEffect() const
 
 double SimpleEQAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    if (static_cast<FilterMode> (parameters.filterMode->load()) != FilterMode_IIR)
+        return getSampleRate() > 0 ? firLength / getSampleRate() : 0.0;
+
+    return tailLengthSeconds.load();
 }
 
 int SimpleEQAudioProcessor::getNumPrograms()
@@ -99,19 +147,67 @@ void SimpleEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlo
     juce::dsp::ProcessSpec spec;
 
     spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = 1;
+    spec.numChannels = getTotalNumOutputChannels();
     spec.sampleRate = sampleRate;
 
-    leftChain.prepare (spec);
-    rightChain.prepare (spec);
+    //the design state below is rebuilt without designLock, so the designer must not be running
+    designer.stopThread (1000);
+
+    //the pool is only held if the mode is on when playback is prepared; its threads all get scratch space here,
+    //so an offline block only has to switch them on
+    updateRenderPool (static_cast<OfflineRendering> (parameters.offlineRendering->load()) == OfflineRendering_Multithreaded);
+    chain.prepare (spec);
+    doubleChain.prepare (spec);
+    svfChain.prepare (spec);
+    doubleSvfChain.prepare (spec);
 
-    updateFilters();
+    doubleScratch.setSize ((int) spec.numChannels, samplesPerBlock);
+    analyzerScratch.setSize ((int) spec.numChannels, samplesPerBlock);
+
+    if (isUsingDoublePrecision())
+    {
+        doubleOversamplers.prepare (spec.numChannels, spec.maximumBlockSize);
+        oversamplers.release();
+    }
+    else
+    {
+        oversamplers.prepare (spec.numChannels, spec.maximumBlockSize);
+        doubleOversamplers.release();
+    }
+
+    linearPhaseDesigner.prepare (firOrder);
+    minimumPhaseDesigner.prepare (firOrder);
+    firCache.prepare (firLength);
+    publishedFirKernels.forEachSlot ([] (PartitionedKernel& kernel)
+    {
+        kernel.prepare (firLength, getPartitionLength (Partition_64));
+    });
+    publishedZeroLatencyKernels.forEachSlot ([] (NonUniformKernel& kernel) { kernel.prepare (firLength); });
+    publishedFirPhase = -1;
+    firIsStale = true;
+
+    convolver.prepare (spec.numChannels, firLength, sampleRate);
+    zeroLatencyConvolver.prepare (spec.numChannels, firLength);
+
+    //the sample rate may have changed, so every stage needs redesigning
+    markAllFiltersDirty();
+    appliedPrecision = -1;
+    designPendingChanges();
+    applyPublishedCoefficients();
+    applyPublishedFir();
+
+    //the oversamplers were rebuilt, so report the latency even if nothing else changed
+    reportedLatency = -1;
+    updateLatency();
+
+    wasRenderingOffline = isNonRealtime();
+    prepared = true;
+    designer.startThread();
 
     leftChannelFifo.prepare (samplesPerBlock);
     rightChannelFifo.prepare (samplesPerBlock);
 
     osc.initialise ([] (float x) { return std::sin (x); });
-    spec.numChannels = getTotalNumOutputChannels();
     osc.prepare (spec);
     osc.setFrequency (1000);
 }
@@ -120,6 +216,13 @@ void SimpleEQAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    designer.stopThread (1000);
+    prepared = false;
+    zeroLatencyConvolver.release();
+    updateRenderPool (false);
+
+    //the editor may still change the settings it draws
+    designer.startThread();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -129,12 +232,18 @@ bool SimpleEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
+    // Mono, stereo, surround and ambisonic buses all share one coefficient set,
+    // and the cascade filters them in SIMD-width channel groups. A stereo bus
+    // can also run each channel, or mid and side, from a coefficient set of its own.
     // Some plugin hosts, such as certain GarageBand versions, will only
     // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    const auto& output = layouts.getMainOutputChannelSet();
+    if (output != juce::AudioChannelSet::mono()
+     && output != juce::AudioChannelSet::stereo()
+     && output != juce::AudioChannelSet::create5point1()
+     && output != juce::AudioChannelSet::create7point1point4()
+     && output != juce::AudioChannelSet::ambisonic (1)
+     && output != juce::AudioChannelSet::ambisonic (3))
         return false;
 
     // This checks if the input layout matches the output layout
@@ -148,9 +257,9 @@ bool SimpleEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
 }
 #endif
 
-void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+template <typename SampleType>
+void SimpleEQAudioProcessor::beginBlock (juce::AudioBuffer<SampleType>& buffer)
 {
-    juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -163,7 +272,92 @@ void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juc
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    updateFilters();
+    //JUCE hands parameter changes over without a sample offset, so a new design takes effect from the start of a block;
+    //offline renders design in line, so a change applies from the block it lands before,
+    //unless the designer is still finishing a pass, in which case the next block picks it up
+    auto offline = isNonRealtime();
+
+    if (offline)
+    {
+        const juce::SpinLock::ScopedTryLockType tl (designLock);
+
+        if (tl.isLocked())
+            designPendingChanges();
+    }
+    else if (wasRenderingOffline)
+    {
+        //the designer sat out the render, so hand back whatever it left
+        designer.notify();
+    }
+
+    wasRenderingOffline = offline;
+
+    applyPublishedCoefficients();
+
+    zeroLatencyConvolver.setRealtime (! offline);
+    applyOfflineRendering();
+
+    applyPublishedFir();
+    updateLatency();
+}
+
+template <typename SampleType>
+bool SimpleEQAudioProcessor::isSilentWithDecayedTail (const juce::AudioBuffer<SampleType>& buffer)
+{
+    auto numSamples = buffer.getNumSamples();
+
+    if (buffer.getMagnitude (0, numSamples) != SampleType (0))
+    {
+        silentSamples = 0;
+        tailCleared = false;
+        return false;
+    }
+
+    //keep filtering silence until the tail has rung out
+    auto activeTailSamples = appliedFilterMode != FilterMode_IIR
+                           ? firLength + getConvolutionLatency()
+                           : tailSamples;
+
+    if (silentSamples < activeTailSamples)
+    {
+        silentSamples += numSamples;
+        return false;
+    }
+
+    //what is left in the states is below the threshold, so drop it rather
+    //than let it come back when the input starts again
+    if (! tailCleared)
+    {
+        chain.reset();
+        doubleChain.reset();
+        svfChain.reset();
+        doubleSvfChain.reset();
+        oversamplers.reset (appliedOversampling);
+        doubleOversamplers.reset (appliedOversampling);
+        convolver.reset();
+        zeroLatencyConvolver.reset();
+        tailCleared = true;
+    }
+
+    ++skippedSilentBlocks;
+    return true;
+}
+
+void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    juce::ScopedNoDenormals noDenormals;
+    beginBlock (buffer);
+
+    //silence in gives silence out, so there is nothing to filter
+    if (isSilentWithDecayedTail (buffer))
+    {
+        leftChannelFifo.update (buffer);
+
+        if (buffer.getNumChannels() > Channel::Right)
+            rightChannelFifo.update (buffer);
+
+        return;
+    }
 
     juce::dsp::AudioBlock<float> block (buffer);
 
@@ -172,17 +366,138 @@ void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juc
     // juce::dsp::ProcessContextReplacing<float> stereoContext (block);
     // osc.process (stereoContext);
 
-    auto leftBlock = block.getSingleChannelBlock (0);
-    auto rightBlock = block.getSingleChannelBlock (1);
+    if (appliedFilterMode != FilterMode_IIR)
+    {
+        processFir (block);
+    }
+    else
+    {
+        oversamplers.process (block, appliedOversampling, [this] (const juce::dsp::AudioBlock<float>& filterBlock)
+        {
+            processIIR (filterBlock);
+        });
+    }
 
-    juce::dsp::ProcessContextReplacing<float> leftContext (leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext (rightBlock);
+    leftChannelFifo.update (buffer);
 
-    leftChain.process (leftContext);
-    rightChain.process (rightContext);
+    if (buffer.getNumChannels() > Channel::Right)
+        rightChannelFifo.update (buffer);
+}
 
-    leftChannelFifo.update (buffer);
-    rightChannelFifo.update (buffer);
+void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    juce::ScopedNoDenormals noDenormals;
+    beginBlock (buffer);
+
+    juce::dsp::AudioBlock<double> block (buffer);
+
+    if (! isSilentWithDecayedTail (buffer))
+    {
+        if (appliedFilterMode != FilterMode_IIR)
+        {
+            processFir (block);
+        }
+        else
+        {
+            doubleOversamplers.process (block, appliedOversampling, [this] (const juce::dsp::AudioBlock<double>& filterBlock)
+            {
+                if (appliedSmoothing != Smoothing_Off)
+                    doubleSvfChain.process (filterBlock);
+                else
+                    doubleChain.process (filterBlock);
+            });
+        }
+    }
+
+    updateAnalyzer (buffer);
+}
+
+template <typename SampleType>
+void SimpleEQAudioProcessor::processFir (const juce::dsp::AudioBlock<SampleType>& block)
+{
+    if (appliedConvolution == Convolution_ZeroLatency)
+        zeroLatencyConvolver.process (block);
+    else
+        convolver.process (block);
+}
+
+void SimpleEQAudioProcessor::processIIR (const juce::dsp::AudioBlock<float>& block)
+{
+    //a TPT filter has none of the direct form's trouble with low cutoffs, so precision does not apply
+    if (appliedSmoothing != Smoothing_Off)
+    {
+        svfChain.process (block);
+        return;
+    }
+
+    switch (floatPathPrecision)
+    {
+        case Precision_Float:
+            chain.process (block);
+            break;
+        case Precision_Auto:
+            //doubleChain holds just the low-cut, chain holds the rest
+            processInDoublePrecision (block);
+            chain.process (block);
+            break;
+        case Precision_Double:
+            processInDoublePrecision (block);
+            break;
+    }
+}
+
+void SimpleEQAudioProcessor::processInDoublePrecision (const juce::dsp::AudioBlock<float>& block)
+{
+    auto numChannels = juce::jmin (block.getNumChannels(), (size_t) doubleScratch.getNumChannels());
+    auto maxChunk = (size_t) doubleScratch.getNumSamples();
+
+    for (size_t start = 0; start < block.getNumSamples(); start += maxChunk)
+    {
+        auto numSamples = juce::jmin (maxChunk, block.getNumSamples() - start);
+
+        for (size_t ch = 0; ch < numChannels; ++ch)
+        {
+            auto* source = block.getChannelPointer (ch) + start;
+            std::copy (source, source + numSamples, doubleScratch.getWritePointer ((int) ch));
+        }
+
+        juce::dsp::AudioBlock<double> scratchBlock (doubleScratch.getArrayOfWritePointers(), numChannels, numSamples);
+        doubleChain.process (scratchBlock);
+
+        for (size_t ch = 0; ch < numChannels; ++ch)
+        {
+            auto* result = doubleScratch.getReadPointer ((int) ch);
+            std::copy (result, result + numSamples, block.getChannelPointer (ch) + start);
+        }
+    }
+}
+
+void SimpleEQAudioProcessor::updateAnalyzer (const juce::AudioBuffer<double>& buffer)
+{
+    //the copy is only worth making for a FIFO something reads
+    if (! leftChannelFifo.hasConsumer() && ! rightChannelFifo.hasConsumer())
+        return;
+
+    //the analyzer FIFOs only take float, so feed them through a preallocated copy
+    auto numChannels = juce::jmin (buffer.getNumChannels(), analyzerScratch.getNumChannels());
+    auto maxChunk = analyzerScratch.getNumSamples();
+
+    for (int start = 0; start < buffer.getNumSamples(); start += maxChunk)
+    {
+        auto numSamples = juce::jmin (maxChunk, buffer.getNumSamples() - start);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto* source = buffer.getReadPointer (ch, start);
+            std::copy (source, source + numSamples, analyzerScratch.getWritePointer (ch));
+        }
+
+        juce::AudioBuffer<float> chunk (analyzerScratch.getArrayOfWritePointers(), numChannels, numSamples);
+        leftChannelFifo.update (chunk);
+
+        if (numChannels > Channel::Right)
+            rightChannelFifo.update (chunk);
+    }
 }
 
 //==============================================================================
@@ -217,121 +532,949 @@ void SimpleEQAudioProcessor::setStateInformation (const void* data, int sizeInBy
     if (tree.isValid())
     {
         apvts.replaceState (tree);
-        updateFilters();
+        markAllFiltersDirty();
+    }
+}
+
+StereoMode SimpleEQAudioProcessor::getActiveStereoMode() const
+{
+    auto mode = static_cast<StereoMode> (parameters.stereoMode->load());
+
+    //the smoothed chains and the FIR modes have a single chain, which every channel runs
+    auto runsCascade = static_cast<FilterMode> (parameters.filterMode->load()) == FilterMode_IIR
+                    && static_cast<Smoothing> (parameters.smoothing->load()) == Smoothing_Off;
+
+    if (getTotalNumOutputChannels() != 2 || ! runsCascade)
+        return Stereo_Linked;
+
+    return mode;
+}
+
+juce::String getBandParameterID (int band, const juce::String& parameterName)
+{
+    //band 1 is the single peak the chain had before, so automation and sessions that use it still find it
+    if (band == 0)
+        return "Peak " + parameterName;
+
+    return "Band " + juce::String (band + 1) + " " + parameterName;
+}
+
+juce::String getParameterID (ParameterSet set, const juce::String& parameterID)
+{
+    switch (set)
+    {
+        case ParameterSet_Side:  return "Side " + parameterID;
+        case ParameterSet_Right: return "Right " + parameterID;
+        default:                 break;
     }
+
+    return parameterID;
+}
+
+static ParameterBindings::ChainParameters bindChain (juce::AudioProcessorValueTreeState& apvts, ParameterSet set)
+{
+    auto bind = [&apvts, set] (const juce::String& parameterID) { return apvts.getRawParameterValue (getParameterID (set, parameterID)); };
+
+    ParameterBindings::ChainParameters chain { bind ("LowCut Freq"), bind ("LowCut Slope"), bind ("LowCut Type"),
+                                               bind ("HighCut Freq"), bind ("HighCut Slope"), bind ("HighCut Type"), {} };
+
+    for (int band = 0; band < numBands; ++band)
+    {
+        chain.bands[(size_t) band] = { bind (getBandParameterID (band, "Freq")),
+                                       bind (getBandParameterID (band, "Gain")),
+                                       bind (getBandParameterID (band, "Quality")),
+                                       bind (getBandParameterID (band, "Type")),
+                                       bind (getBandParameterID (band, "On")) };
+    }
+
+    return chain;
+}
+
+ParameterBindings::ParameterBindings (juce::AudioProcessorValueTreeState& apvts)
+    : chains { bindChain (apvts, ParameterSet_Main), bindChain (apvts, ParameterSet_Side), bindChain (apvts, ParameterSet_Right) },
+      precision (apvts.getRawParameterValue ("Precision")),
+      smoothing (apvts.getRawParameterValue ("Smoothing")),
+      oversampling (apvts.getRawParameterValue ("Oversampling")),
+      filterMode (apvts.getRawParameterValue ("Filter Mode")),
+      partitionSize (apvts.getRawParameterValue ("Partition Size")),
+      convolution (apvts.getRawParameterValue ("Convolution")),
+      stereoMode (apvts.getRawParameterValue ("Stereo Mode")),
+      iirForm (apvts.getRawParameterValue ("IIR Form")),
+      offlineRendering (apvts.getRawParameterValue ("Offline Rendering"))
+{
+    for (int set = 0; set < numParameterSets; ++set)
+        publishChainSettings (static_cast<ParameterSet> (set));
+}
+
+void ParameterBindings::publishChainSettings (ParameterSet set)
+{
+    const auto& chain = chains[(size_t) set];
+    std::array<std::atomic<float>*, numChainValues> sources { chain.lowCutFreq, chain.lowCutSlope, chain.lowCutType,
+                                                              chain.highCutFreq, chain.highCutSlope, chain.highCutType };
+    for (size_t band = 0; band < (size_t) numBands; ++band)
+    {
+        const auto& b = chain.bands[band];
+        auto* first = sources.data() + numCutValues + numBandValues * band;
+        first[0] = b.freq, first[1] = b.gainInDecibels, first[2] = b.quality, first[3] = b.type, first[4] = b.enabled;
+    }
+
+    auto& snapshot = snapshots[(size_t) set];
+    auto begun = snapshot.sequence.load (std::memory_order_relaxed) + 1;
+    snapshot.sequence.store (begun, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+
+    for (size_t i = 0; i < numChainValues; ++i)
+        snapshot.values[i].store (sources[i]->load(), std::memory_order_relaxed);
+
+    snapshot.sequence.store (begun + 1, std::memory_order_release);
+}
+
+juce::uint32 ParameterBindings::getChainSettingsVersion() const
+{
+    juce::uint32 version = 0;
+
+    for (const auto& snapshot : snapshots)
+        version += snapshot.sequence.load (std::memory_order_acquire);
+
+    return version;
 }
 
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
+ChainSettings ParameterBindings::getChainSettings (ParameterSet set) const
 {
+    const auto& snapshot = snapshots[(size_t) set];
+    std::array<float, numChainValues> values;
+
+    for (;;)
+    {
+        auto before = snapshot.sequence.load (std::memory_order_acquire);
+
+        if ((before & 1) == 0)
+        {
+            for (size_t i = 0; i < numChainValues; ++i)
+                values[i] = snapshot.values[i].load (std::memory_order_relaxed);
+
+            std::atomic_thread_fence (std::memory_order_acquire);
+
+            if (snapshot.sequence.load (std::memory_order_relaxed) == before)
+                break;
+        }
+    }
+
     ChainSettings settings;
 
-    settings.lowCutFreq = apvts.getRawParameterValue ("LowCut Freq")->load();
-    settings.highCutFreq = apvts.getRawParameterValue ("HighCut Freq")->load();
-    settings.peakFreq = apvts.getRawParameterValue ("Peak Freq")->load();
-    settings.peakGainInDecibels = apvts.getRawParameterValue ("Peak Gain")->load();
-    settings.peakQuality = apvts.getRawParameterValue ("Peak Quality")->load();
-    settings.lowCutSlope = static_cast<Slope> (apvts.getRawParameterValue ("LowCut Slope")->load());
-    settings.highCutSlope = static_cast<Slope> (apvts.getRawParameterValue ("HighCut Slope")->load());
+    settings.lowCutFreq = values[0];
+    settings.lowCutSlope = static_cast<Slope> (values[1]);
+    settings.lowCutType = static_cast<CutType> (values[2]);
+    settings.highCutFreq = values[3];
+    settings.highCutSlope = static_cast<Slope> (values[4]);
+    settings.highCutType = static_cast<CutType> (values[5]);
+
+    for (size_t band = 0; band < (size_t) numBands; ++band)
+    {
+        const auto* first = values.data() + numCutValues + numBandValues * band;
+        auto& b = settings.bands[band];
+
+        b.freq = first[0];
+        b.gainInDecibels = first[1];
+        b.quality = first[2];
+        b.type = static_cast<BandType> (first[3]);
+        b.enabled = first[4] >= 0.5f;
+    }
+
+    return settings;
+}
+
+SvfChainSettings getSvfChainSettings (const ChainSettings& chainSettings)
+{
+    SvfChainSettings settings;
+
+    settings.lowCutFrequency = chainSettings.lowCutFreq;
+    settings.lowCutOrder = isLowCutNeutral (chainSettings) ? 0 : getCutOrder (chainSettings.lowCutSlope);
+    settings.lowCutType = chainSettings.lowCutType;
+
+    for (size_t band = 0; band < (size_t) numBands; ++band)
+    {
+        const auto& source = chainSettings.bands[band];
+        auto& dest = settings.bands[band];
+
+        dest.type = source.type;
+        dest.frequency = source.freq;
+        dest.quality = source.quality;
+        dest.gainInDecibels = source.gainInDecibels;
+
+        //a flat band stays in, so its gain can glide through 0 dB
+        dest.active = source.enabled;
+    }
+
+    settings.highCutFrequency = chainSettings.highCutFreq;
+    settings.highCutOrder = isHighCutNeutral (chainSettings) ? 0 : getCutOrder (chainSettings.highCutSlope);
+    settings.highCutType = chainSettings.highCutType;
 
     return settings;
 }
 
-Coefficients makePeakFilter (const ChainSettings& chainSettings, double sampleRate)
+FirDesignKey getFirDesignKey (const ChainSettings& chainSettings, FilterMode phase,
+                              OversamplingOrder oversampling, double sampleRate)
 {
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter (sampleRate,
-                                                                chainSettings.peakFreq,
-                                                                chainSettings.peakQuality,
-                                                                juce::Decibels::decibelsToGain (chainSettings.peakGainInDecibels));
+    //tenths of a cent, hundredths of a dB and thousandths of Q; a neutral stage keys as zeros
+    auto pitch = [] (float frequency) { return juce::roundToInt (std::log2 (frequency) * 12000.f); };
+    FirDesignKey key;
+
+    if (! isLowCutNeutral (chainSettings))
+    {
+        key.values[0] = pitch (chainSettings.lowCutFreq);
+        key.values[1] = chainSettings.lowCutSlope + 1;
+        key.values[2] = chainSettings.lowCutType;
+    }
+
+    if (! isHighCutNeutral (chainSettings))
+    {
+        key.values[3] = pitch (chainSettings.highCutFreq);
+        key.values[4] = chainSettings.highCutSlope + 1;
+        key.values[5] = chainSettings.highCutType;
+    }
+
+    key.values[6] = phase;
+    key.values[7] = oversampling;
+    key.values[8] = juce::roundToInt (sampleRate);
+
+    for (size_t band = 0; band < (size_t) numBands; ++band)
+    {
+        const auto& settings = chainSettings.bands[band];
+        if (isBandNeutral (settings))
+            continue;
+
+        auto* values = key.values.data() + FirDesignKey::numChainValues + FirDesignKey::numBandValues * band;
+        values[0] = settings.type + 1;
+        values[1] = pitch (settings.freq);
+        values[2] = juce::roundToInt (settings.gainInDecibels * 100.f);
+        values[3] = juce::roundToInt (settings.quality * 1000.f);
+    }
 
+    return key;
 }
 
-void SimpleEQAudioProcessor::updatePeakFilter (const ChainSettings& chainSettings)
+void SimpleEQAudioProcessor::designPendingChanges()
 {
-    auto peakCoefficients = makePeakFilter (chainSettings, getSampleRate());
-    updateCoefficients(leftChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
-    updateCoefficients(rightChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    auto chainChanged = designChangedStages();
+    auto mode = static_cast<FilterMode> (parameters.filterMode->load());
+
+    //the FIR follows the chain, and has to be re-partitioned when the partition size changes
+    auto partitionSize = static_cast<PartitionSize> (parameters.partitionSize->load());
+    auto firChanged = chainChanged || partitionSize != designedPartitionSize;
+
+    //IIR mode runs no FIR, so a change only withdraws the published one; an FIR mode waits for the next
+    if (mode == FilterMode_IIR)
+    {
+        if (firChanged)
+        {
+            firIsStale = true;
+            publishedFirPhase.store (-1, std::memory_order_release);
+        }
+
+        return;
+    }
+
+    if (firChanged || firIsStale || mode != designedFirPhase)
+        designFir (mode, partitionSize);
 }
 
-void updateCoefficients (Coefficients& old, const Coefficients& replacements)
+void SimpleEQAudioProcessor::publishChangedSettings (juce::uint32 changedStages)
 {
-    *old = *replacements;
+    for (int index = 0; index < numParameterSets; ++index)
+    {
+        auto set = static_cast<ParameterSet> (index);
+
+        if ((changedStages & getAllStages (set)) != 0)
+            parameters.publishChainSettings (set);
+    }
 }
 
-void SimpleEQAudioProcessor::updateLowCutFilters (const ChainSettings& chainSettings)
+void SimpleEQAudioProcessor::designOnDesignerThread()
 {
-    auto lowCutCoefficients = makeLowCutFilter (chainSettings, getSampleRate());
+    //there is no rate to design for until prepareToPlay(), which marks every stage dirty again
+    if (! prepared)
+    {
+        publishChangedSettings (dirtyStages.exchange (0));
+        return;
+    }
 
-    auto& leftLowCut = leftChain.get<ChainPositions::LowCut>();
-    updateCutFilter (leftLowCut, lowCutCoefficients, chainSettings.lowCutSlope);
+    //offline the audio thread designs each block itself
+    if (! isNonRealtime())
+    {
+        const juce::SpinLock::ScopedTryLockType tl (designLock);
 
-    auto& rightLowCut = rightChain.get<ChainPositions::LowCut>();
-    updateCutFilter (rightLowCut, lowCutCoefficients, chainSettings.lowCutSlope);
+        if (tl.isLocked())
+            designPendingChanges();
+    }
+
+    updateConvolutionWorker();
+}
+
+void SimpleEQAudioProcessor::updateConvolutionWorker()
+{
+    //the zero-latency convolver only has jobs for its worker while it runs an FIR mode
+    auto isZeroLatencyFir = static_cast<FilterMode> (parameters.filterMode->load()) != FilterMode_IIR
+                         && static_cast<ConvolutionEngine> (parameters.convolution->load()) == Convolution_ZeroLatency;
+
+    zeroLatencyConvolver.setWorkerEnabled (isZeroLatencyFir);
 }
 
-void SimpleEQAudioProcessor::updateHighCutFilters (const ChainSettings& chainSettings)
+bool SimpleEQAudioProcessor::designChangedStages()
 {
-    auto highCutCoefficients = makeHighCutFilter (chainSettings, getSampleRate());
+    //clear the flags before reading the parameters, so a change that lands
+    //while we are designing marks the stage dirty again for the next pass
+    auto changedStages = dirtyStages.exchange (0);
+    publishChangedSettings (changedStages);
+
+    //a new oversampling factor moves every stage to a new rate
+    auto oversampling = static_cast<OversamplingOrder> (parameters.oversampling->load());
+    if (oversampling != designedCoefficients.oversamplingOrder)
+        changedStages = allStages;
+
+    //a set the mode does not read is left alone, so it has to catch up when it comes back into use;
+    //linked therefore designs one chain, and the other modes a second, never a third
+    auto stereoMode = getActiveStereoMode();
+    auto stereoModeChanged = stereoMode != designedCoefficients.stereoMode;
+
+    for (int index = 1; index < numParameterSets; ++index)
+    {
+        auto set = static_cast<ParameterSet> (index);
+
+        if (! isParameterSetInUse (set, stereoMode))
+            changedStages &= ~getAllStages (set);
+        else if (! isParameterSetInUse (set, designedCoefficients.stereoMode))
+            changedStages |= getAllStages (set);
+    }
 
-    auto& leftHighCut = leftChain.get<ChainPositions::HighCut>();
-    updateCutFilter (leftHighCut, highCutCoefficients, chainSettings.highCutSlope);
+    //the parallel form is expanded here too, so a change of form needs a new publish but not a new design
+    auto iirForm = static_cast<IirForm> (parameters.iirForm->load());
+    auto iirFormChanged = iirForm != designedCoefficients.iirForm;
+    designedCoefficients.iirForm = iirForm;
 
-    auto& rightHighCut = rightChain.get<ChainPositions::HighCut>();
-    updateCutFilter (rightHighCut, highCutCoefficients, chainSettings.highCutSlope);
+    if (changedStages == 0 && ! stereoModeChanged)
+    {
+        if (iirFormChanged)
+            publishDesign();
+
+        return false;
+    }
+
+    auto oversamplingFactor = 1 << oversampling;
+    auto sampleRate = getSampleRate() * oversamplingFactor;
+    designedCoefficients.oversamplingOrder = oversampling;
+    designedCoefficients.stereoMode = stereoMode;
+
+    //the main chain goes first, so the second can share the stages they have in common
+    auto secondSet = getSecondParameterSet (stereoMode);
+    designChangedStages (ParameterSet_Main, changedStages, sampleRate);
+
+    if (secondSet != ParameterSet_Main)
+        designChangedStages (secondSet, changedStages, sampleRate);
+
+    //the tail is judged in double, which is the most accurate view of where the poles are
+    auto maxDecaySamples = (int) (maxTailLengthSeconds * sampleRate);
+    auto decaySamples = getDecayLengthInSamples (designedCoefficients.chains[ParameterSet_Main].doublePrecision,
+                                                 tailThreshold, maxDecaySamples);
+
+    if (secondSet != ParameterSet_Main)
+        decaySamples = juce::jmax (decaySamples, getDecayLengthInSamples (designedCoefficients.chains[(size_t) secondSet].doublePrecision,
+                                                                          tailThreshold, maxDecaySamples));
+
+    designedCoefficients.tailSamples = (decaySamples + oversamplingFactor - 1) / oversamplingFactor;
+    tailLengthSeconds = sampleRate > 0 ? decaySamples / sampleRate : 0.0;
+
+    publishDesign();
+    return true;
 }
 
-void SimpleEQAudioProcessor::updateFilters()
+void SimpleEQAudioProcessor::publishDesign()
 {
-    auto chainSettings = getChainSettings (apvts);
+    //the parallel form only runs on a mono bus, which is always linked, so only the main chain is expanded;
+    //the expansion is too slow for the audio thread, so each way a precision splits the chain is done here
+    auto& mainDesign = designedCoefficients.chains[ParameterSet_Main];
+    auto isParallel = designedCoefficients.iirForm == IirForm_Parallel;
+
+    mainDesign.singlePrecisionParallel.reset();
+    mainDesign.singlePrecisionParallelWithoutLowCut.reset();
+    mainDesign.doublePrecisionParallel.reset();
+    mainDesign.doublePrecisionParallelLowCutOnly.reset();
+
+    if (isParallel)
+    {
+        mainDesign.singlePrecisionParallel = getParallelForm (mainDesign.singlePrecision);
+        mainDesign.singlePrecisionParallelWithoutLowCut = getParallelForm (getWithoutLowCut (mainDesign.singlePrecision));
+        mainDesign.doublePrecisionParallel = getParallelForm (mainDesign.doublePrecision);
+        mainDesign.doublePrecisionParallelLowCutOnly = getParallelForm (getLowCutOnly (mainDesign.doublePrecision));
+    }
 
-    updateLowCutFilters (chainSettings);
-    updatePeakFilter (chainSettings);
-    updateHighCutFilters (chainSettings);
+    //always publish a complete set, so the audio thread never sees a half-designed chain
+    publishedCoefficients.getWriteSlot() = designedCoefficients;
+    publishedCoefficients.publish();
 }
 
-juce::AudioProcessorValueTreeState::ParameterLayout
-    SimpleEQAudioProcessor::createParameterLayout()
+void SimpleEQAudioProcessor::designChangedStages (ParameterSet set, juce::uint32 changedStages, double sampleRate)
 {
-    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+    auto lowCutChanged = (changedStages & getLowCutStage (set)) != 0;
+    auto highCutChanged = (changedStages & getHighCutStage (set)) != 0;
 
-    layout.add (std::make_unique<juce::AudioParameterFloat> ("LowCut Freq", 
-                                                             "LowCut Freq",
-                                                             juce::NormalisableRange<float> (20.f, 20000.f, 1.f, 0.25f),
-                                                             20.f));
+    auto chainSettings = parameters.getChainSettings (set);
+    auto& designed = designedCoefficients.chains[(size_t) set];
 
-    layout.add (std::make_unique<juce::AudioParameterFloat> ("HighCut Freq", 
-                                                             "HighCut Freq",
-                                                             juce::NormalisableRange<float> (20.f, 20000.f, 1.f, 0.25f),
-                                                             20000.f));
+    //a stage set the same way as the main chain's is copied from it rather than designed again
+    const auto& mainDesign = designedCoefficients.chains[ParameterSet_Main];
+    const auto& mainSettings = mainDesign.settings;
+    auto isSecond = set != ParameterSet_Main;
+
+    auto& singlePrecision = designed.singlePrecision;
+    auto& doublePrecision = designed.doublePrecision;
+
+    //the FIR cache is keyed on the settings each stage was last designed from
+    auto& designedSettings = designed.settings;
+
+    if (lowCutChanged)
+    {
+        designedSettings.lowCutFreq = chainSettings.lowCutFreq;
+        designedSettings.lowCutSlope = chainSettings.lowCutSlope;
+        designedSettings.lowCutType = chainSettings.lowCutType;
+    }
+
+    if (highCutChanged)
+    {
+        designedSettings.highCutFreq = chainSettings.highCutFreq;
+        designedSettings.highCutSlope = chainSettings.highCutSlope;
+        designedSettings.highCutType = chainSettings.highCutType;
+    }
+
+    if (lowCutChanged && isLowCutNeutral (chainSettings))
+    {
+        singlePrecision.lowCut.numSections = 0;
+        doublePrecision.lowCut.numSections = 0;
+        designed.lowCutIsIllConditioned = false;
+    }
+    else if (lowCutChanged && isSecond && haveSameLowCut (chainSettings, mainSettings))
+    {
+        singlePrecision.lowCut = mainDesign.singlePrecision.lowCut;
+        doublePrecision.lowCut = mainDesign.doublePrecision.lowCut;
+        designed.lowCutIsIllConditioned = mainDesign.lowCutIsIllConditioned;
+    }
+    else if (lowCutChanged)
+    {
+        designLowCut (singlePrecision.lowCut, chainSettings, sampleRate);
+        designLowCut (doublePrecision.lowCut, chainSettings, sampleRate);
+
+        designed.lowCutIsIllConditioned = false;
+        for (int i = 0; i < doublePrecision.lowCut.numSections; ++i)
+        {
+            if (1.0 - getPoleRadius (doublePrecision.lowCut.sections[i]) < illConditionedPoleDistance)
+                designed.lowCutIsIllConditioned = true;
+        }
+
+        ++coefficientRecomputes;
+    }
+
+    auto bandsChanged = false;
+
+    for (int band = 0; band < numBands; ++band)
+    {
+        if ((changedStages & getBandStage (set, band)) == 0)
+            continue;
+
+        //a neutral band is not designed, and is left out of the chain
+        const auto& settings = chainSettings.bands[(size_t) band];
+        designedSettings.bands[(size_t) band] = settings;
+        designed.bandActive[(size_t) band] = ! isBandNeutral (settings);
+        bandsChanged = true;
+
+        if (designed.bandActive[(size_t) band] && isSecond && haveSameBand (settings, mainSettings.bands[(size_t) band]))
+        {
+            designed.singlePrecisionBands[(size_t) band] = mainDesign.singlePrecisionBands[(size_t) band];
+            designed.doublePrecisionBands[(size_t) band] = mainDesign.doublePrecisionBands[(size_t) band];
+        }
+        else if (designed.bandActive[(size_t) band])
+        {
+            designBand (designed.singlePrecisionBands[(size_t) band], settings, sampleRate);
+            designBand (designed.doublePrecisionBands[(size_t) band], settings, sampleRate);
+            ++coefficientRecomputes;
+        }
+    }
+
+    if (bandsChanged)
+    {
+        packBands (singlePrecision.bands, designed.singlePrecisionBands, designed.bandActive);
+        packBands (doublePrecision.bands, designed.doublePrecisionBands, designed.bandActive);
+    }
+
+    if (highCutChanged && isHighCutNeutral (chainSettings))
+    {
+        singlePrecision.highCut.numSections = 0;
+        doublePrecision.highCut.numSections = 0;
+    }
+    else if (highCutChanged && isSecond && haveSameHighCut (chainSettings, mainSettings))
+    {
+        singlePrecision.highCut = mainDesign.singlePrecision.highCut;
+        doublePrecision.highCut = mainDesign.doublePrecision.highCut;
+    }
+    else if (highCutChanged)
+    {
+        designHighCut (singlePrecision.highCut, chainSettings, sampleRate);
+        designHighCut (doublePrecision.highCut, chainSettings, sampleRate);
+        ++coefficientRecomputes;
+    }
+}
+
+void SimpleEQAudioProcessor::designFir (FilterMode phase, PartitionSize partitionSize)
+{
+    //the FIR modes run the main chain on every channel
+    const auto& designed = designedCoefficients;
+    const auto& chain = designed.chains[ParameterSet_Main];
+    auto key = getFirDesignKey (chain.settings, phase, designed.oversamplingOrder, getSampleRate());
+    auto* impulse = firCache.find (key);
+
+    if (impulse == nullptr)
+    {
+        //sampling the response at the filter rate means oversampling also removes the FIR's cramping
+        auto filterSampleRate = getSampleRate() * (1 << designed.oversamplingOrder);
+        const auto& chainCoefficients = chain.doublePrecision;
+
+        impulse = phase == FilterMode_MinimumPhase
+                ? minimumPhaseDesigner.design (chainCoefficients, filterSampleRate, getSampleRate())
+                : linearPhaseDesigner.design (chainCoefficients, filterSampleRate, getSampleRate());
+
+        firCache.store (key, impulse);
+        ++firDesigns;
+    }
+
+    //the cache holds impulses, so even a cached design is partitioned afresh;
+    //both engines get a kernel, so switching between them never waits for a design
+    publishedFirKernels.getWriteSlot().design (impulse, firLength, getPartitionLength (partitionSize), designerTransforms);
+    publishedFirKernels.publish();
+
+    publishedZeroLatencyKernels.getWriteSlot().design (impulse, firLength, designerTransforms);
+    publishedZeroLatencyKernels.publish();
+
+    publishedFirPhase.store (phase, std::memory_order_release);
+    designedPartitionSize = partitionSize;
+    designedFirPhase = phase;
+    firIsStale = false;
+}
+
+void SimpleEQAudioProcessor::applyPublishedCoefficients()
+{
+    //a precision, smoothing or form change needs no new design, only a new look at the one in use
+    auto chainChanged = publishedCoefficients.acquire();
+    applyCoefficients (publishedCoefficients.getReadSlot(), chainChanged);
+}
+
+void SimpleEQAudioProcessor::applyCoefficients (const DesignedCoefficients& designed, bool chainChanged)
+{
+    auto precision = static_cast<Precision> (parameters.precision->load());
+    auto smoothing = static_cast<Smoothing> (parameters.smoothing->load());
+    auto iirForm = static_cast<IirForm> (parameters.iirForm->load());
+
+    if (! chainChanged && precision == appliedPrecision && smoothing == appliedSmoothing && iirForm == appliedIirForm)
+        return;
+
+    appliedPrecision = precision;
+    appliedIirForm = iirForm;
+    const auto& mainDesign = designed.chains[ParameterSet_Main];
+    const auto& secondDesign = designed.chains[(size_t) getSecondParameterSet (designed.stereoMode)];
+
+    if (designed.oversamplingOrder != appliedOversampling)
+        applyOversampling (designed.oversamplingOrder);
+
+    //the smoothed chains glide towards every new design, and jump to a new rate;
+    //like the FIR modes, they run the main chain on every channel
+    auto svfSettings = getSvfChainSettings (mainDesign.settings);
+    auto filterSampleRate = getSampleRate() * (1 << designed.oversamplingOrder);
+    svfChain.setTarget (svfSettings, filterSampleRate);
+    doubleSvfChain.setTarget (svfSettings, filterSampleRate);
+
+    if (smoothing != appliedSmoothing)
+        applySmoothing (smoothing);
+
+    //the half-band filters ring for about as long as they delay
+    tailSamples = designed.tailSamples + getOversamplingLatency();
+
+    //the design only has a second chain where the cascade can run it, see getActiveStereoMode()
+    auto midSide = designed.stereoMode == Stereo_MidSide;
+    auto hasSecondChain = designed.stereoMode != Stereo_Linked;
+    chain.setMidSide (midSide);
+    doubleChain.setMidSide (midSide);
+
+    //only a mono bus has the lanes free for it; the cascades fall back on their own otherwise
+    chain.setParallelForm (iirForm == IirForm_Parallel);
+    doubleChain.setParallelForm (iirForm == IirForm_Parallel);
+
+    //the second chain only adds coefficients to the lanes, not a second pass;
+    //a mono bus is always linked, so only the main chain comes with a parallel form
+    auto setCoefficients = [hasSecondChain] (auto& cascade, const auto& mainCoefficients, const auto& secondCoefficients,
+                                             const auto& mainParallel)
+    {
+        if (hasSecondChain)
+            cascade.setCoefficients (mainCoefficients, secondCoefficients);
+        else
+            cascade.setCoefficients (mainCoefficients, mainParallel ? &*mainParallel : nullptr);
+    };
+
+    if (isUsingDoublePrecision())
+    {
+        setCoefficients (doubleChain, mainDesign.doublePrecision, secondDesign.doublePrecision, mainDesign.doublePrecisionParallel);
+        return;
+    }
+
+    auto lowCutIsIllConditioned = mainDesign.lowCutIsIllConditioned || (hasSecondChain && secondDesign.lowCutIsIllConditioned);
+
+    floatPathPrecision = precision;
+    if (precision == Precision_Auto && ! lowCutIsIllConditioned)
+        floatPathPrecision = Precision_Float;
+
+    switch (floatPathPrecision)
+    {
+        case Precision_Float:
+            setCoefficients (chain, mainDesign.singlePrecision, secondDesign.singlePrecision, mainDesign.singlePrecisionParallel);
+            break;
+        case Precision_Auto:
+            //each cascade encodes and decodes on its own, which comes to the same as one matrix around both
+            setCoefficients (doubleChain, getLowCutOnly (mainDesign.doublePrecision), getLowCutOnly (secondDesign.doublePrecision),
+                             mainDesign.doublePrecisionParallelLowCutOnly);
+            setCoefficients (chain, getWithoutLowCut (mainDesign.singlePrecision), getWithoutLowCut (secondDesign.singlePrecision),
+                             mainDesign.singlePrecisionParallelWithoutLowCut);
+            break;
+        case Precision_Double:
+            setCoefficients (doubleChain, mainDesign.doublePrecision, secondDesign.doublePrecision, mainDesign.doublePrecisionParallel);
+            break;
+    }
+}
+
+void SimpleEQAudioProcessor::applyPublishedFir()
+{
+    auto mode = static_cast<FilterMode> (parameters.filterMode->load());
+    auto engine = static_cast<ConvolutionEngine> (parameters.convolution->load());
 
-    layout.add (std::make_unique<juce::AudioParameterFloat> ("Peak Freq", 
-                                                             "Peak Freq",
+    //an FIR mode only takes over once kernels of its phase have been published for the current chain,
+    //and its engine is free to take one straight after the reset below; until then the old path plays on
+    if (mode != FilterMode_IIR)
+    {
+        auto engineIsFree = engine == Convolution_ZeroLatency ? zeroLatencyConvolver.canAcceptKernel()
+                                                              : convolver.canAcceptKernel();
+
+        if (mode != publishedFirPhase.load (std::memory_order_acquire) || ! engineIsFree)
+        {
+            mode = appliedFilterMode;
+            engine = appliedConvolution;
+        }
+    }
+
+    if (mode != appliedFilterMode || engine != appliedConvolution)
+    {
+        appliedFilterMode = mode;
+        appliedConvolution = engine;
+
+        //no path's state means anything to another
+        convolver.reset();
+        zeroLatencyConvolver.reset();
+        chain.reset();
+        doubleChain.reset();
+        svfChain.reset();
+        doubleSvfChain.reset();
+        oversamplers.reset (appliedOversampling);
+        doubleOversamplers.reset (appliedOversampling);
+    }
+
+    if (appliedFilterMode == FilterMode_IIR)
+        return;
+
+    //only the engine in use takes kernels, the first after the reset without a fade;
+    //one that arrives mid-crossfade stays published until the fade is over
+    if (appliedConvolution == Convolution_ZeroLatency)
+    {
+        if (zeroLatencyConvolver.canAcceptKernel() && publishedZeroLatencyKernels.acquire())
+            zeroLatencyConvolver.setKernel (publishedZeroLatencyKernels.getReadSlot());
+    }
+    else if (convolver.canAcceptKernel() && publishedFirKernels.acquire())
+    {
+        convolver.setKernel (publishedFirKernels.getReadSlot());
+    }
+}
+
+void SimpleEQAudioProcessor::applyOversampling (OversamplingOrder order)
+{
+    appliedOversampling = order;
+
+    //the filter states belong to the old rate, and the new oversampler may hold stale samples
+    chain.reset();
+    doubleChain.reset();
+    oversamplers.reset (order);
+    doubleOversamplers.reset (order);
+}
+
+void SimpleEQAudioProcessor::applySmoothing (Smoothing smoothing)
+{
+    appliedSmoothing = smoothing;
+
+    if (smoothing != Smoothing_Off)
+    {
+        svfChain.setControlInterval (getControlInterval (smoothing));
+        doubleSvfChain.setControlInterval (getControlInterval (smoothing));
+    }
+
+    //the two structures hold their state differently, so neither can take over the other's
+    chain.reset();
+    doubleChain.reset();
+    svfChain.reset();
+    doubleSvfChain.reset();
+}
+
+void SimpleEQAudioProcessor::applyOfflineRendering()
+{
+    //only offline may the audio thread wait on the pool's workers; either way the switch allocates nothing,
+    //and without a pool from prepareToPlay() the cascades stay on this thread
+    auto offline = isNonRealtime();
+    auto multithreaded = offline
+                      && static_cast<OfflineRendering> (parameters.offlineRendering->load()) == OfflineRendering_Multithreaded;
+
+    chain.setRenderingOffline (offline);
+    doubleChain.setRenderingOffline (offline);
+    chain.setMultithreaded (multithreaded);
+    doubleChain.setMultithreaded (multithreaded);
+}
+
+void SimpleEQAudioProcessor::updateRenderPool (bool shouldHoldPool)
+{
+    //the chains may only be pointed at a new pool while the audio thread is not running them
+    if (shouldHoldPool && renderPool == nullptr)
+        renderPool = std::make_unique<juce::SharedResourcePointer<SharedRenderPool>>();
+
+    auto* pool = shouldHoldPool ? &renderPool->getObject() : nullptr;
+    chain.setWorkerPool (pool);
+    doubleChain.setWorkerPool (pool);
+
+    if (! shouldHoldPool)
+        renderPool.reset();
+}
+
+int SimpleEQAudioProcessor::getOversamplingLatency() const
+{
+    if (isUsingDoublePrecision())
+        return doubleOversamplers.isPrepared() ? doubleOversamplers.getLatencyInSamples (appliedOversampling) : 0;
+
+    return oversamplers.isPrepared() ? oversamplers.getLatencyInSamples (appliedOversampling) : 0;
+}
+
+void SimpleEQAudioProcessor::updateLatency()
+{
+    auto latency = getOversamplingLatency();
+
+    if (appliedFilterMode == FilterMode_LinearPhase)
+        latency = linearPhaseDesigner.getLatencyInSamples() + getConvolutionLatency();
+    else if (appliedFilterMode == FilterMode_MinimumPhase)
+        latency = minimumPhaseDesigner.getLatencyInSamples() + getConvolutionLatency();
+
+    if (latency != reportedLatency)
+    {
+        reportedLatency = latency;
+        setLatencySamples (latency);
+    }
+}
+
+int SimpleEQAudioProcessor::getConvolutionLatency() const
+{
+    if (appliedConvolution == Convolution_ZeroLatency)
+        return zeroLatencyConvolver.getLatencyInSamples();
+
+    return convolver.getLatencyInSamples();
+}
+
+double SimpleEQAudioProcessor::getFilterSampleRate() const
+{
+    return getSampleRate() * (1 << (int) parameters.oversampling->load());
+}
+
+juce::String SimpleEQAudioProcessor::getKernelDescription() const
+{
+    //the chain sees a whole block at a time, so that is the size worth reporting
+    auto speedup = chain.getStateSpaceSpeedup ((size_t) juce::jmax (1, getBlockSize()));
+
+    return getKernelDiagnostics() + ", " + juce::String ((int) chain.getChannelsPerGroup()) + " channels per pass"
+         + ", state-space x" + juce::String (speedup, 2) + (isNonRealtime() ? " (in use)" : " (offline only)");
+}
+
+void SimpleEQAudioProcessor::markAllFiltersDirty()
+{
+    //the designer publishes every set's snapshot before redesigning
+    dirtyStages = allStages;
+    designer.notify();
+}
+
+/** Adds a band's frequency, gain and quality; band 1's are the single peak's from before there were bands. */
+static void addBandShapeParameters (juce::AudioProcessorValueTreeState::ParameterLayout& layout, ParameterSet set, int band)
+{
+    auto id = [set, band] (const juce::String& name) { return getParameterID (set, getBandParameterID (band, name)); };
+
+    //band 1 keeps the peak's default, the others start spread evenly in octaves across the audible range
+    auto defaultFreq = band == 0 ? 750.f : (float) juce::roundToInt (20.f * std::pow (1000.f, (band + 0.5f) / numBands));
+
+    layout.add (std::make_unique<juce::AudioParameterFloat> (id ("Freq"),
+                                                             id ("Freq"),
                                                              juce::NormalisableRange<float> (20.f, 20000.f, 1.f, 0.25f),
-                                                             750.f));
+                                                             defaultFreq));
 
-    layout.add (std::make_unique<juce::AudioParameterFloat> ("Peak Gain", 
-                                                             "Peak Gain",
+    layout.add (std::make_unique<juce::AudioParameterFloat> (id ("Gain"),
+                                                             id ("Gain"),
                                                              juce::NormalisableRange<float> (-24.f, 24.f, 0.5f, 1.f),
                                                              0.f));
 
-    layout.add (std::make_unique<juce::AudioParameterFloat> ("Peak Quality", 
-                                                             "Peak Quality",
+    layout.add (std::make_unique<juce::AudioParameterFloat> (id ("Quality"),
+                                                             id ("Quality"),
                                                              juce::NormalisableRange<float> (0.1f, 10.f, 0.05f, 1.f),
                                                              1.f));
+}
+
+/**
+ Adds the bands of one parameter set past band 1's shape: band 1's type and
+ switch, then every other band's five parameters, "Band 2 Freq" to "Band N On".
+ */
+static void addBandParameters (juce::AudioProcessorValueTreeState::ParameterLayout& layout, ParameterSet set)
+{
+    for (int band = 0; band < numBands; ++band)
+    {
+        auto id = [set, band] (const juce::String& name) { return getParameterID (set, getBandParameterID (band, name)); };
+
+        if (band > 0)
+            addBandShapeParameters (layout, set, band);
+
+        layout.add (std::make_unique<juce::AudioParameterChoice> (id ("Type"),
+                                                                  id ("Type"),
+                                                                  juce::StringArray ("Bell", "Low Shelf", "High Shelf", "Notch", "Tilt"),
+                                                                  Band_Bell));
+
+        layout.add (std::make_unique<juce::AudioParameterBool> (id ("On"), id ("On"), true));
+    }
+}
+
+/** Adds the cut frequencies and slopes and band 1's shape of one parameter set, in the order the single-peak chain had them, with IDs from getParameterID(). */
+static void addChainParameters (juce::AudioProcessorValueTreeState::ParameterLayout& layout, ParameterSet set)
+{
+    layout.add (std::make_unique<juce::AudioParameterFloat> (getParameterID (set, "LowCut Freq"),
+                                                             getParameterID (set, "LowCut Freq"),
+                                                             juce::NormalisableRange<float> (20.f, 20000.f, 1.f, 0.25f),
+                                                             20.f));
+
+    layout.add (std::make_unique<juce::AudioParameterFloat> (getParameterID (set, "HighCut Freq"),
+                                                             getParameterID (set, "HighCut Freq"),
+                                                             juce::NormalisableRange<float> (20.f, 20000.f, 1.f, 0.25f),
+                                                             20000.f));
+
+    addBandShapeParameters (layout, set, 0);
 
     juce::StringArray cutChoice = juce::StringArray ("12 dB/Oct", 
                                                      "24 dB/Oct",
                                                      "36 dB/Oct",
-                                                     "48 dB/Oct");
-
-    layout.add (std::make_unique<juce::AudioParameterChoice> ("LowCut Slope",
-                                                              "LowCut Slope",
+                                                     "48 dB/Oct",
+                                                     "60 dB/Oct",
+                                                     "72 dB/Oct",
+                                                     "84 dB/Oct",
+                                                     "96 dB/Oct");
+
+    layout.add (std::make_unique<juce::AudioParameterChoice> (getParameterID (set, "LowCut Slope"),
+                                                              getParameterID (set, "LowCut Slope"),
                                                               cutChoice,
                                                               0));
 
-    layout.add (std::make_unique<juce::AudioParameterChoice> ("HighCut Slope",
-                                                              "HighCut Slope",
+    layout.add (std::make_unique<juce::AudioParameterChoice> (getParameterID (set, "HighCut Slope"),
+                                                              getParameterID (set, "HighCut Slope"),
                                                               cutChoice,
                                                               0));
+}
+
+/** Adds the response type of each cut of one parameter set. */
+static void addCutTypeParameters (juce::AudioProcessorValueTreeState::ParameterLayout& layout, ParameterSet set)
+{
+    //a Linkwitz-Riley cut is -6 dB at its frequency, so a low and a high cut meeting there sum flat
+    juce::StringArray cutTypeChoice = juce::StringArray ("Butterworth", "Linkwitz-Riley");
+
+    layout.add (std::make_unique<juce::AudioParameterChoice> (getParameterID (set, "LowCut Type"),
+                                                              getParameterID (set, "LowCut Type"),
+                                                              cutTypeChoice,
+                                                              Cut_Butterworth));
+
+    layout.add (std::make_unique<juce::AudioParameterChoice> (getParameterID (set, "HighCut Type"),
+                                                              getParameterID (set, "HighCut Type"),
+                                                              cutTypeChoice,
+                                                              Cut_Butterworth));
+}
+
+juce::AudioProcessorValueTreeState::ParameterLayout
+    SimpleEQAudioProcessor::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+
+    addChainParameters (layout, ParameterSet_Main);
+
+    layout.add (std::make_unique<juce::AudioParameterChoice> ("Precision",
+                                                              "Precision",
+                                                              juce::StringArray ("Float", "Auto", "Double"),
+                                                              Precision_Auto));
+
+    //smoothing runs the chain as TPT state variable filters, recomputed every 8, 16 or 32 samples
+    layout.add (std::make_unique<juce::AudioParameterChoice> ("Smoothing",
+                                                              "Smoothing",
+                                                              juce::StringArray ("Off", "Every 8", "Every 16", "Every 32"),
+                                                              Smoothing_Off));
+
+    layout.add (std::make_unique<juce::AudioParameterChoice> ("Oversampling",
+                                                              "Oversampling",
+                                                              juce::StringArray ("Off", "2x", "4x", "8x"),
+                                                              Oversampling_Off));
+
+    layout.add (std::make_unique<juce::AudioParameterChoice> ("Filter Mode",
+                                                              "Filter Mode",
+                                                              juce::StringArray ("IIR", "Linear Phase", "Minimum Phase"),
+                                                              FilterMode_IIR));
+
+    //smaller partitions lower the latency of the FIR modes but cost more CPU
+    layout.add (std::make_unique<juce::AudioParameterChoice> ("Partition Size",
+                                                              "Partition Size",
+                                                              juce::StringArray ("64", "128", "256", "512", "1024"),
+                                                              Partition_256));
+
+    //zero latency adds no delay beyond the FIR's own, at the cost of a background thread
+    layout.add (std::make_unique<juce::AudioParameterChoice> ("Convolution",
+                                                              "Convolution",
+                                                              juce::StringArray ("Uniform", "Zero Latency"),
+                                                              Convolution_Uniform));
+
+    //the bands and cut types came after all of the above, so they follow them rather than push them along
+    addBandParameters (layout, ParameterSet_Main);
+    addCutTypeParameters (layout, ParameterSet_Main);
+
+    //Mid/Side runs the main set on the mid and the side set on the side of a stereo bus,
+    //Unlinked runs the main set on the left and the right set on the right
+    layout.add (std::make_unique<juce::AudioParameterChoice> ("Stereo Mode",
+                                                              "Stereo Mode",
+                                                              juce::StringArray ("Linked", "Mid/Side", "Unlinked"),
+                                                              Stereo_Linked));
+
+    //the other sets come last, so the parameters hosts already know keep their places
+    for (auto set : { ParameterSet_Side, ParameterSet_Right })
+    {
+        addChainParameters (layout, set);
+        addBandParameters (layout, set);
+        addCutTypeParameters (layout, set);
+    }
+
+    //parallel form runs a mono bus's sections side by side in the SIMD lanes, for designs it can represent accurately
+    layout.add (std::make_unique<juce::AudioParameterChoice> ("IIR Form",
+                                                              "IIR Form",
+                                                              juce::StringArray ("Cascade", "Parallel"),
+                                                              IirForm_Cascade));
+
+    //multithreaded renders share the channel groups out across a worker per core; real time is never affected
+    layout.add (std::make_unique<juce::AudioParameterChoice> ("Offline Rendering",
+                                                              "Offline Rendering",
+                                                              juce::StringArray ("Single Thread", "Multithreaded"),
+                                                              OfflineRendering_SingleThread));
 
     return layout;
 }
@@ -10,220 +10,378 @@
 
 #include <JuceHeader.h>
 #include <JucePluginDefines.h>
+#include "FilterCoefficients.h"
+#include "BiquadCascade.h"
+#include "SmoothedSvfChain.h"
+#include "OversamplerBank.h"
+#include "PartitionedConvolution.h"
+#include "NonUniformConvolution.h"
+#include "FirDesign.h"
+#include "SampleFifo.h"
 
-template<typename T>
-struct Fifo
+enum Slope
 {
-    void prepare (int numChannels, int numSamples)
-    {
-        static_assert (std::is_same_v<T, juce::AudioBuffer<float>>,
-                       "prepare (numChannels, numSamples) should only be used when the Fifo is holding juce::AudioBuffer<float>");
-        for (auto& buffer : buffers)
-        {
-            buffer.setSize (numChannels,
-                            numSamples,
-                            false,   //clear everything?
-                            true,    //including the extra space?
-                            true);   //avoid reallocating if you can?
-            buffer.clear();
-        }
-    }
-
-    void prepare (size_t numElements)
-    {
-        static_assert (std::is_same_v<T, std::vector<float>>,
-                       "prepare (numElements) should only be used when the Fifo is holding std::vector<float>");
-        for (auto& buffer : buffers)
-        {
-            buffer.clear();
-            buffer.resize (numElements, 0);
-        }
-    }
+    Slope_12,
+    Slope_24,
+    Slope_36,
+    Slope_48,
+    Slope_60,
+    Slope_72,
+    Slope_84,
+    Slope_96
+};
 
-    bool push (const T& t)
-    {
-        auto write = fifo.write(1);
-        if (write.blockSize1 > 0)
-        {
-            buffers[write.startIndex1] = t;
-            return true;
-        }
+/** Returns the filter order of a cut with the given slope: 6 dB/oct per order. */
+constexpr int getCutOrder (Slope slope) { return 2 * (slope + 1); }
 
-        return false;
-    }
+static_assert (getCutOrder (Slope_96) == maxCutFilterOrder, "The steepest slope has to fit the cut's sections");
 
-    bool pull (T& t)
-    {
-        auto read = fifo.read(1);
-        if (read.blockSize1 > 0)
-        {
-            t = buffers[read.startIndex1];
-            return true;
-        }
+enum Precision
+{
+    Precision_Float,
+    Precision_Auto,
+    Precision_Double
+};
 
-        return false;
-    }
+/** How the IIR chain is realised: as a cascade of biquads, or, on a mono bus, in parallel form where it expands accurately. */
+enum IirForm
+{
+    IirForm_Cascade,
+    IirForm_Parallel
+};
 
-    int getNumAvailableForReading() const
-    {
-        return fifo.getNumReady();
-    }
-private:
-    static constexpr int Capacity = 30;
-    std::array<T, Capacity> buffers;
-    juce::AbstractFifo fifo { Capacity };
+/** Whether offline renders share the IIR chain's channels out across a pool of worker threads. */
+enum OfflineRendering
+{
+    OfflineRendering_SingleThread,
+    OfflineRendering_Multithreaded
 };
 
-enum Channel
+enum FilterMode
 {
-    Left,
-    Right
+    FilterMode_IIR,
+    FilterMode_LinearPhase,
+    FilterMode_MinimumPhase
 };
 
-template<typename BlockType>
-struct SingleChannelSampleFifo
+enum ConvolutionEngine
 {
-    SingleChannelSampleFifo (Channel ch) : channelToUse (ch)
-    {
-        prepared.set (false);
-    }
+    Convolution_Uniform,
+    Convolution_ZeroLatency
+};
 
-    void update (const BlockType& buffer)
-    {
-        jassert (prepared.get());
-        jassert (buffer.getNumChannels() > channelToUse );
-        auto* channelPtr = buffer.getReadPointer (channelToUse);
-        
-        for( int i = 0; i < buffer.getNumSamples(); ++i )
-        {
-            pushNextSampleIntoFifo (channelPtr[i]);
-        }
-    }
+enum StereoMode
+{
+    Stereo_Linked,
+    Stereo_MidSide,
+    Stereo_Unlinked
+};
 
-    void prepare (int bufferSize)
-    {
-        prepared.set (false);
-        size.set (bufferSize);
-        
-        bufferToFill.setSize (1,             //channel
-                              bufferSize,    //num samples
-                              false,         //keepExistingContent
-                              true,          //clear extra space
-                              true);         //avoid reallocating
-        audioBufferFifo.prepare (1, bufferSize);
-        fifoIndex = 0;
-        prepared.set (true);
-    }
-    //==============================================================================
-    int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
-    bool isPrepared() const { return prepared.get(); }
-    int getSize() const { return size.get(); }
-    //==============================================================================
-    bool getAudioBuffer (BlockType& buf) { return audioBufferFifo.pull (buf); }
-private:
-    Channel channelToUse;
-    int fifoIndex = 0;
-    Fifo<BlockType> audioBufferFifo;
-    BlockType bufferToFill;
-    juce::Atomic<bool> prepared = false;
-    juce::Atomic<int> size = 0;
-
-    void pushNextSampleIntoFifo (float sample)
-    {
-        if (fifoIndex == bufferToFill.getNumSamples())
-        {
-            auto ok = audioBufferFifo.push (bufferToFill);
+/**
+ The chain parameters come in sets. The main set drives every channel when
+ linked, the mid in Mid/Side and the left channel when unlinked; the side
+ and right sets are only read in their own modes.
+ */
+enum ParameterSet
+{
+    ParameterSet_Main,
+    ParameterSet_Side,
+    ParameterSet_Right,
+    numParameterSets
+};
 
-            juce::ignoreUnused (ok);
+/** Returns the set the second channel of a stereo pair, or its side, runs in the given mode. */
+constexpr ParameterSet getSecondParameterSet (StereoMode mode)
+{
+    return mode == Stereo_MidSide ? ParameterSet_Side
+         : mode == Stereo_Unlinked ? ParameterSet_Right
+                                   : ParameterSet_Main;
+}
 
-            fifoIndex = 0;
-        }
+/** Returns true if the mode reads the set, so that it has to be kept designed. */
+constexpr bool isParameterSetInUse (ParameterSet set, StereoMode mode)
+{
+    return set == ParameterSet_Main || set == getSecondParameterSet (mode);
+}
 
-        bufferToFill.setSample (0, fifoIndex, sample);
-        ++fifoIndex;
-    }
-};
+//how many parametric bands the plugin has parameters for; the filters can run up to maxBands
+static constexpr int numBands = 8;
+static_assert (numBands <= maxBands, "The filters cannot run that many bands");
 
-enum Slope
+struct BandSettings
 {
-    Slope_12,
-    Slope_24,
-    Slope_36,
-    Slope_48
+    BandType type { Band_Bell };
+    float freq { 1000.f }, gainInDecibels { 0 }, quality { 1.f };
+    bool enabled { true };
 };
 
 struct ChainSettings
 {
-    float peakFreq { 0 }, peakGainInDecibels { 0 }, peakQuality { 1.f };
+    std::array<BandSettings, numBands> bands;
     float lowCutFreq { 0 }, highCutFreq { 0 };
     Slope lowCutSlope { Slope::Slope_12 }, highCutSlope { Slope::Slope_12 };  
+    CutType lowCutType { Cut_Butterworth }, highCutType { Cut_Butterworth };
 };
 
-ChainSettings getChainSettings (juce::AudioProcessorValueTreeState& apvts);
+/** Returns the ID of one of a band's parameters, e.g. "Band 2 Freq" for band 1 and "Freq"; band 0's are "Peak Freq" and so on. */
+juce::String getBandParameterID (int band, const juce::String& parameterName);
 
-using Filter = juce::dsp::IIR::Filter<float>;
-using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
-using MonoChain = juce::dsp::ProcessorChain<CutFilter, Filter, CutFilter>;
+/** Returns the ID of a chain parameter in the given set: the main set's is the plain ID, the others have "Side " or "Right " in front. */
+juce::String getParameterID (ParameterSet set, const juce::String& parameterID);
 
-enum ChainPositions
+/**
+ Every parameter's raw value, bound by ID once when the processor is built,
+ so that nothing afterwards looks a parameter up by name.
+
+ Each set's chain parameters are also kept as one snapshot behind a seqlock.
+ The designer rewrites it with publishChainSettings() when one of them has
+ changed, and getChainSettings() retries if it overlaps a rewrite, so a
+ reader never pairs a frequency from one change with a slope from another.
+ */
+class ParameterBindings
+{
+public:
+    explicit ParameterBindings (juce::AudioProcessorValueTreeState& apvts);
+
+    struct BandParameters
+    {
+        std::atomic<float>* freq;
+        std::atomic<float>* gainInDecibels;
+        std::atomic<float>* quality;
+        std::atomic<float>* type;
+        std::atomic<float>* enabled;
+    };
+
+    struct ChainParameters
+    {
+        std::atomic<float>* lowCutFreq;
+        std::atomic<float>* lowCutSlope;
+        std::atomic<float>* lowCutType;
+        std::atomic<float>* highCutFreq;
+        std::atomic<float>* highCutSlope;
+        std::atomic<float>* highCutType;
+        std::array<BandParameters, numBands> bands;
+    };
+
+    const std::array<ChainParameters, numParameterSets> chains;
+
+    std::atomic<float>* const precision;
+    std::atomic<float>* const smoothing;
+    std::atomic<float>* const oversampling;
+    std::atomic<float>* const filterMode;
+    std::atomic<float>* const partitionSize;
+    std::atomic<float>* const convolution;
+    std::atomic<float>* const stereoMode;
+    std::atomic<float>* const iirForm;
+    std::atomic<float>* const offlineRendering;
+
+    /**
+     Copies a set's chain parameters into its snapshot. The seqlock has a
+     single writer: only whichever thread is designing may call this.
+     */
+    void publishChainSettings (ParameterSet set);
+
+    /** Returns the newest complete snapshot of a set, without locking. */
+    ChainSettings getChainSettings (ParameterSet set) const;
+
+    /** Returns a number that changes whenever any set's snapshot is rewritten. */
+    juce::uint32 getChainSettingsVersion() const;
+private:
+    static constexpr size_t numCutValues = 6, numBandValues = 5;
+    static constexpr size_t numChainValues = numCutValues + numBandValues * numBands;
+
+    struct Snapshot
     {
-        LowCut,
-        Peak,
-        HighCut
+        //the cuts' values, then each band's, in the order their parameters are declared above
+        std::array<std::atomic<float>, numChainValues> values;
+
+        //odd while a publish is under way
+        std::atomic<juce::uint32> sequence { 0 };
     };
 
-using Coefficients = Filter::CoefficientsPtr;
-void updateCoefficients (Coefficients& old, const Coefficients& replacements);
+    std::array<Snapshot, numParameterSets> snapshots;
+};
+
+//a cut parked at the end of its range, or a band that is off or has no gain, is treated as switched off
+inline bool isLowCutNeutral (const ChainSettings& chainSettings) { return chainSettings.lowCutFreq <= 20.f; }
+inline bool isHighCutNeutral (const ChainSettings& chainSettings) { return chainSettings.highCutFreq >= 20000.f; }
 
-Coefficients makePeakFilter (const ChainSettings& chainSettings, double sampleRate);
+//two sets with a stage set the same way share that stage's design
+inline bool haveSameLowCut (const ChainSettings& a, const ChainSettings& b)
+{
+    return a.lowCutFreq == b.lowCutFreq && a.lowCutSlope == b.lowCutSlope && a.lowCutType == b.lowCutType;
+}
 
-template <int Index, typename ChainType, typename CoefficientsType>
-void update (ChainType& chain, const CoefficientsType& coefficients)
+inline bool haveSameHighCut (const ChainSettings& a, const ChainSettings& b)
 {
-    updateCoefficients (chain.template get<Index>().coefficients, coefficients[Index]);
-    chain.template setBypassed<Index> (false);
+    return a.highCutFreq == b.highCutFreq && a.highCutSlope == b.highCutSlope && a.highCutType == b.highCutType;
 }
-template <typename ChainType, typename CoefficientsType>
-void updateCutFilter (ChainType& chain, const CoefficientsType& coefficients, const Slope& slope)
+
+inline bool haveSameBand (const BandSettings& a, const BandSettings& b)
 {
-    chain.template setBypassed<0> (true);
-    chain.template setBypassed<1> (true);
-    chain.template setBypassed<2> (true);
-    chain.template setBypassed<3> (true);
-    switch (slope)
+    return a.type == b.type && a.freq == b.freq && a.gainInDecibels == b.gainInDecibels
+        && a.quality == b.quality && a.enabled == b.enabled;
+}
+
+inline bool isBandNeutral (const BandSettings& band)
+{
+    //a notch cuts whatever its gain
+    return ! band.enabled || (band.gainInDecibels == 0.f && band.type != Band_Notch);
+}
+
+/** Returns the settings for the smoothed chain, with neutral cuts switched off. */
+SvfChainSettings getSvfChainSettings (const ChainSettings& chainSettings);
+
+/** Returns the key FirDesignCache files the FIR for these settings under. */
+FirDesignKey getFirDesignKey (const ChainSettings& chainSettings, FilterMode phase,
+                              OversamplingOrder oversampling, double sampleRate);
+
+//the processor's designers, which design in place without allocating
+template <typename NumericType>
+void designBand (BiquadCoefficients<NumericType>& dest, const BandSettings& band, double sampleRate)
+{
+    dest = makeBandBiquad (band.type, sampleRate,
+                           static_cast<NumericType> (band.freq),
+                           static_cast<NumericType> (band.quality),
+                           static_cast<NumericType> (band.gainInDecibels));
+}
+
+template <typename NumericType>
+void designLowCut (CutCoefficients<NumericType>& dest, const ChainSettings& chainSettings, double sampleRate)
+{
+    designHighPassCut (dest, chainSettings.lowCutType, static_cast<NumericType> (chainSettings.lowCutFreq), sampleRate,
+                       getCutOrder (chainSettings.lowCutSlope));
+}
+
+template <typename NumericType>
+void designHighCut (CutCoefficients<NumericType>& dest, const ChainSettings& chainSettings, double sampleRate)
+{
+    designLowPassCut (dest, chainSettings.highCutType, static_cast<NumericType> (chainSettings.highCutFreq), sampleRate,
+                      getCutOrder (chainSettings.highCutSlope));
+}
+
+/** Packs the designs of the bands that are not neutral into the chain, in band order. */
+template <typename NumericType>
+void packBands (BandCoefficients<NumericType>& dest,
+                const std::array<BiquadCoefficients<NumericType>, numBands>& designs,
+                const std::array<bool, numBands>& active)
+{
+    dest.numSections = 0;
+
+    for (int band = 0; band < numBands; ++band)
     {
-        case Slope_48:
-        {
-            update<3> (chain, coefficients);
-        }
-        case Slope_36:
-        {
-            update<2> (chain, coefficients);
-        }
-        case Slope_24:
-        {
-            update<1> (chain, coefficients);
-        }
-        case Slope_12:
-        {
-            update<0> (chain, coefficients);
-        }
+        if (! active[(size_t) band])
+            continue;
+
+        dest.sections[(size_t) dest.numSections] = designs[(size_t) band];
+        dest.bandIndices[(size_t) dest.numSections] = band;
+        ++dest.numSections;
     }
 }
 
-inline auto makeLowCutFilter (const ChainSettings& chainSettings, double sampleRate)
+/** Designs the whole chain as the processor runs it, with the neutral stages left out. */
+template <typename NumericType>
+void designChain (ChainCoefficients<NumericType>& dest, const ChainSettings& chainSettings, double sampleRate)
 {
-    return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod (chainSettings.lowCutFreq,
-                                                                                        sampleRate,
-                                                                                        2 * (chainSettings.lowCutSlope + 1));
+    if (isLowCutNeutral (chainSettings))
+        dest.lowCut.numSections = 0;
+    else
+        designLowCut (dest.lowCut, chainSettings, sampleRate);
+
+    std::array<BiquadCoefficients<NumericType>, numBands> designs;
+    std::array<bool, numBands> active;
+
+    for (size_t band = 0; band < (size_t) numBands; ++band)
+    {
+        active[band] = ! isBandNeutral (chainSettings.bands[band]);
+        if (active[band])
+            designBand (designs[band], chainSettings.bands[band], sampleRate);
+    }
+
+    packBands (dest.bands, designs, active);
+
+    if (isHighCutNeutral (chainSettings))
+        dest.highCut.numSections = 0;
+    else
+        designHighCut (dest.highCut, chainSettings, sampleRate);
 }
 
-inline auto makeHighCutFilter (const ChainSettings& chainSettings, double sampleRate)
+/** The design of one parameter set's chain. */
+struct DesignedChain
 {
-    return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod (chainSettings.highCutFreq,
-                                                                                        sampleRate,
-                                                                                        2 * (chainSettings.highCutSlope + 1));
-}
+    ChainCoefficients<float> singlePrecision;
+    ChainCoefficients<double> doublePrecision;
+
+    //every band's last design, active or not, which the chains pack their bands from
+    std::array<BiquadCoefficients<float>, numBands> singlePrecisionBands;
+    std::array<BiquadCoefficients<double>, numBands> doublePrecisionBands;
+    std::array<bool, numBands> bandActive {};
+
+    //true when the low-cut poles sit close enough to the unit circle that
+    //single precision adds audible noise and limit cycles
+    bool lowCutIsIllConditioned = false;
+
+    //the settings each stage was last designed from, which key the FIR cache
+    ChainSettings settings;
+
+    //the chain in parallel form, as each precision runs it; only designed for IIR Form Parallel, and empty where it does not expand
+    std::optional<ParallelCoefficients<float>> singlePrecisionParallel, singlePrecisionParallelWithoutLowCut;
+    std::optional<ParallelCoefficients<double>> doublePrecisionParallel, doublePrecisionParallelLowCutOnly;
+};
+
+/** A complete design of the chains, as the designer hands it to the audio thread in one publish. */
+struct DesignedCoefficients
+{
+    std::array<DesignedChain, numParameterSets> chains;
+
+    //only the chains the mode reads are kept designed
+    StereoMode stereoMode = Stereo_Linked;
+
+    //samples, at the host rate, for the slowest active pole to ring down below tailThreshold
+    int tailSamples = 0;
+
+    //the chains were designed for the host rate times 2^oversamplingOrder
+    OversamplingOrder oversamplingOrder = Oversampling_Off;
+
+    IirForm iirForm = IirForm_Cascade;
+};
+
+/**
+ Designs the biquads, and the FIR modes' kernels from them, off the audio
+ thread. It sleeps until notify() wakes it: the stage listeners do after
+ marking a stage dirty, and it listens to the parameters it reads outside
+ the stages itself. Listeners can run on the audio thread, which may signal
+ a parked thread but never waits on one. Between designs it starts and
+ stops the zero-latency convolver's worker, which only runs while that
+ engine does.
+ */
+struct CoefficientDesigner : juce::Thread,
+                             juce::AudioProcessorValueTreeState::Listener
+{
+    CoefficientDesigner (std::function<void()> designPendingChanges)
+        : juce::Thread ("SimpleEQ Designer"),
+          designPending (std::move (designPendingChanges))
+    {
+    }
+
+    void run() override
+    {
+        //a notify() that lands mid-design leaves the event set, so the change is never missed
+        while (! threadShouldExit())
+        {
+            designPending();
+            wait (-1);
+        }
+    }
+
+    void parameterChanged (const juce::String&, float) override { notify(); }
+
+    //the parameters the design reads besides the stages' own
+    inline static const juce::StringArray parameterIDs { "Oversampling", "Filter Mode", "Partition Size", "Convolution",
+                                                         "Stereo Mode", "IIR Form", "Smoothing" };
+private:
+    std::function<void()> designPending;
+};
 
 //==============================================================================
 /**
@@ -244,6 +402,23 @@ public:
     #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
+
+    /** Returns the rate the filters run at: the host rate times the oversampling factor. */
+    double getFilterSampleRate() const;
+
+    /**
+     Returns which build of the SIMD kernels this CPU runs, how many channels
+     share a pass of it, and how the state-space kernel timed against it.
+     */
+    juce::String getKernelDescription() const;
+
+    /** Returns true if the IIR chain is running in parallel form, which needs a mono bus and a design that expands accurately. */
+    bool isRunningParallelForm() const { return chain.isRunningParallelForm() || doubleChain.isRunningParallelForm(); }
+
+    /** Returns how many blocks were passed through untouched because the input and the tails were silent. */
+    int getNumSkippedSilentBlocks() const { return skippedSilentBlocks.get(); }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -268,6 +443,27 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    //==============================================================================
+    /** Returns a consistent snapshot of one set of chain parameters. */
+    ChainSettings getChainSettings (ParameterSet set = ParameterSet_Main) const { return parameters.getChainSettings (set); }
+
+    /** Changes when the designer publishes new chain settings, which can be a little after the parameters change. */
+    juce::uint32 getChainSettingsVersion() const { return parameters.getChainSettingsVersion(); }
+
+    /**
+     Returns the stereo mode the filters actually run in. Mid/Side and
+     Unlinked only take effect where the IIR cascade runs on a stereo pair;
+     anywhere else every channel runs the main set, and this returns
+     Stereo_Linked.
+     */
+    StereoMode getActiveStereoMode() const;
+
+    /** Returns how many times a filter stage has had its coefficients redesigned. */
+    int getNumCoefficientRecomputes() const { return coefficientRecomputes.get(); }
+
+    /** Returns how many FIRs have been designed, not counting those found in the cache. */
+    int getNumFirDesigns() const { return firDesigns.get(); }
+
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
 
@@ -275,15 +471,159 @@ public:
     SingleChannelSampleFifo<BlockType> leftChannelFifo { Channel::Left };
     SingleChannelSampleFifo<BlockType> rightChannelFifo { Channel::Right };
 private:
-    MonoChain leftChain, rightChain;
+    MultiChannelBiquadCascade<float> chain;
+    MultiChannelBiquadCascade<double> doubleChain;
+
+    //with smoothing on, these run in place of the cascades and glide between settings
+    SmoothedSvfChain<float> svfChain;
+    SmoothedSvfChain<double> doubleSvfChain;
+    Smoothing appliedSmoothing = Smoothing_Off;
+
+    //a low-cut pole closer than this to the unit circle is run in double in Precision_Auto
+    static constexpr double illConditionedPoleDistance = 1.0e-2;
+
+    //float buffers only: which parts of the chain run in double
+    Precision floatPathPrecision = Precision_Float;
+    int appliedPrecision = -1;
+    IirForm appliedIirForm = IirForm_Cascade;
+
+    //the pool every instance in the process shares, held only while multithreaded offline rendering is on
+    std::unique_ptr<juce::SharedResourcePointer<SharedRenderPool>> renderPool;
+
+    juce::AudioBuffer<double> doubleScratch;
+    juce::AudioBuffer<float> analyzerScratch;
+
+    //only the bank matching the processing precision is prepared
+    OversamplerBank<float> oversamplers;
+    OversamplerBank<double> doubleOversamplers;
+    OversamplingOrder appliedOversampling = Oversampling_Off;
+
+    //the FIR modes run the chain's response as an FIR of this many taps,
+    //enough to resolve a 20 Hz low-cut
+    static constexpr int firOrder = 14;
+    static constexpr int firLength = 1 << firOrder;
+
+    UniformPartitionedConvolver convolver;
+    NonUniformConvolver zeroLatencyConvolver;
+    FilterMode appliedFilterMode = FilterMode_IIR;
+    ConvolutionEngine appliedConvolution = Convolution_Uniform;
+    int reportedLatency = -1;
+
+    //the phase of the newest published FIR kernels, or -1 while none matches the chain
+    std::atomic<int> publishedFirPhase { -1 };
+
+    //a tail counts as decayed once the slowest pole has fallen below this gain (-100 dB)
+    static constexpr double tailThreshold = 1.0e-5;
+    static constexpr double maxTailLengthSeconds = 10.0;
+
+    //counts digitally silent input; once it reaches the tail length the chain is skipped
+    int silentSamples = 0, tailSamples = 0;
+    bool tailCleared = false;
+    juce::Atomic<int> skippedSilentBlocks { 0 };
+    std::atomic<double> tailLengthSeconds { 0.0 };
+
+    template <typename SampleType>
+    void beginBlock (juce::AudioBuffer<SampleType>& buffer);
+    template <typename SampleType>
+    bool isSilentWithDecayedTail (const juce::AudioBuffer<SampleType>& buffer);
+    void processIIR (const juce::dsp::AudioBlock<float>& block);
+    template <typename SampleType>
+    void processFir (const juce::dsp::AudioBlock<SampleType>& block);
+    void processInDoublePrecision (const juce::dsp::AudioBlock<float>& block);
+    void updateAnalyzer (const juce::AudioBuffer<double>& buffer);
+
+    bool designChangedStages();
+    void designChangedStages (ParameterSet set, juce::uint32 changedStages, double sampleRate);
+    void publishDesign();
+    void publishChangedSettings (juce::uint32 changedStages);
+    void designPendingChanges();
+    void designOnDesignerThread();
+    void updateConvolutionWorker();
+    void designFir (FilterMode phase, PartitionSize partitionSize);
+    void applyPublishedCoefficients();
+    void applyCoefficients (const DesignedCoefficients& designed, bool chainChanged);
+    void applyPublishedFir();
+    void applyOversampling (OversamplingOrder order);
+    void applySmoothing (Smoothing smoothing);
+    void applyOfflineRendering();
+    void updateRenderPool (bool shouldHoldPool);
+    int getOversamplingLatency() const;
+    int getConvolutionLatency() const;
+    void updateLatency();
+
+    void markAllFiltersDirty();
+
+    ParameterBindings parameters { apvts };
+
+    //one bit per stage of each set: the low-cut, the high-cut, then one for each band
+    static constexpr int numStagesPerSet = numBands + 2;
+    static constexpr juce::uint32 getLowCutStage (ParameterSet set) { return 1u << (set * numStagesPerSet); }
+    static constexpr juce::uint32 getHighCutStage (ParameterSet set) { return 2u << (set * numStagesPerSet); }
+    static constexpr juce::uint32 getBandStage (ParameterSet set, int band) { return (4u << band) << (set * numStagesPerSet); }
+    static constexpr juce::uint32 getAllStages (ParameterSet set) { return ((4u << numBands) - 1) << (set * numStagesPerSet); }
+    static constexpr juce::uint32 allStages = getAllStages (ParameterSet_Main) | getAllStages (ParameterSet_Side)
+                                            | getAllStages (ParameterSet_Right);
+    static_assert (numStagesPerSet * numParameterSets <= 32, "Every stage needs a bit of its own");
+
+    //each stage is only redesigned when one of its own parameters has changed
+    std::atomic<juce::uint32> dirtyStages { allStages };
+
+    /**
+     Listens to one stage's parameters. Each stage has its own listener, so a
+     change is routed by which listener hears it rather than by comparing IDs.
+     Hosts may call it on the audio thread, so it only marks the stage dirty
+     and wakes the designer, which publishes the set's snapshot.
+     */
+    struct StageListener : juce::AudioProcessorValueTreeState::Listener
+    {
+        StageListener (std::atomic<juce::uint32>& dirtyStageBits, juce::Thread& designerToWake,
+                       juce::uint32 stageBit, const juce::StringArray& stageParameterIDs)
+            : dirty (dirtyStageBits), designer (designerToWake), stage (stageBit), parameterIDs (stageParameterIDs)
+        {
+        }
+
+        void parameterChanged (const juce::String&, float) override
+        {
+            dirty.fetch_or (stage);
+            designer.notify();
+        }
+
+        std::atomic<juce::uint32>& dirty;
+        juce::Thread& designer;
+        const juce::uint32 stage;
+        const juce::StringArray parameterIDs;
+    };
+
+    juce::OwnedArray<StageListener> stageListeners;
+    juce::Atomic<int> coefficientRecomputes { 0 };
+    juce::Atomic<int> firDesigns { 0 };
+
+    //owned by whichever thread holds designLock; prepareToPlay() stops the designer instead
+    DesignedCoefficients designedCoefficients;
+    LinearPhaseFirDesigner linearPhaseDesigner;
+    MinimumPhaseFirDesigner minimumPhaseDesigner;
+    FirDesignCache firCache;
+    PartitionTransforms designerTransforms;
+    PartitionSize designedPartitionSize = Partition_64;
+    FilterMode designedFirPhase = FilterMode_LinearPhase;
+
+    //set when the chain or partition size changes in IIR mode, so the FIR is designed afresh once an FIR mode is chosen
+    bool firIsStale = true;
 
-    void updatePeakFilter (const ChainSettings& chainSettings);
+    //only ever try-locked, so the audio thread never waits on the designer: whichever is refused leaves the work for its next pass
+    juce::SpinLock designLock;
 
+    //audio thread only: set while it designs in line, so the designer is woken when realtime playback resumes
+    bool wasRenderingOffline = false;
 
+    //only changed while the designer is stopped; until prepareToPlay() it just publishes the snapshots the editor draws
+    bool prepared = false;
 
-    void updateLowCutFilters (const ChainSettings& chainSettings);
-    void updateHighCutFilters (const ChainSettings& chainSettings);
-    void updateFilters();
+    //the designs go from the designer to the audio thread
+    TripleBuffer<DesignedCoefficients> publishedCoefficients;
+    TripleBuffer<PartitionedKernel> publishedFirKernels;
+    TripleBuffer<NonUniformKernel> publishedZeroLatencyKernels;
+    CoefficientDesigner designer { [this] { designOnDesignerThread(); } };
 
     juce::dsp::Oscillator<float> osc;
     //==============================================================================
@@ -0,0 +1,186 @@
+/*
+  ==============================================================================
+
+    The FIFOs that carry audio from the audio thread to the analyzer.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+template<typename T>
+struct Fifo
+{
+    void prepare (int numChannels, int numSamples)
+    {
+        static_assert (std::is_same_v<T, juce::AudioBuffer<float>>,
+                       "prepare (numChannels, numSamples) should only be used when the Fifo is holding juce::AudioBuffer<float>");
+        for (auto& buffer : buffers)
+        {
+            buffer.setSize (numChannels,
+                            numSamples,
+                            false,   //clear everything?
+                            true,    //including the extra space?
+                            true);   //avoid reallocating if you can?
+            buffer.clear();
+        }
+    }
+
+    void prepare (size_t numElements)
+    {
+        static_assert (std::is_same_v<T, std::vector<float>>,
+                       "prepare (numElements) should only be used when the Fifo is holding std::vector<float>");
+        for (auto& buffer : buffers)
+        {
+            buffer.clear();
+            buffer.resize (numElements, 0);
+        }
+    }
+
+    bool push (const T& t)
+    {
+        auto write = fifo.write(1);
+        if (write.blockSize1 > 0)
+        {
+            buffers[write.startIndex1] = t;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool pull (T& t)
+    {
+        auto read = fifo.read(1);
+        if (read.blockSize1 > 0)
+        {
+            t = buffers[read.startIndex1];
+            return true;
+        }
+
+        return false;
+    }
+
+    int getNumAvailableForReading() const
+    {
+        return fifo.getNumReady();
+    }
+private:
+    static constexpr int Capacity = 30;
+    std::array<T, Capacity> buffers;
+    juce::AbstractFifo fifo { Capacity };
+};
+
+enum Channel
+{
+    Left,
+    Right
+};
+
+template<typename BlockType>
+struct SingleChannelSampleFifo
+{
+    SingleChannelSampleFifo (Channel ch) : channelToUse (ch)
+    {
+        prepared.set (false);
+    }
+
+    void update (const BlockType& buffer)
+    {
+        jassert (prepared.get());
+        jassert (buffer.getNumChannels() > channelToUse );
+
+        //with nobody reading, the tap costs one load
+        if (! hasConsumer())
+        {
+            tapping = false;
+            return;
+        }
+
+        //what bufferToFill held from before is stale, so a new reader starts on this block
+        if (! tapping)
+        {
+            fifoIndex = 0;
+            tapping = true;
+        }
+
+        auto* channelPtr = buffer.getReadPointer (channelToUse);
+        auto numSamples = buffer.getNumSamples();
+
+        //copy whole spans, up to where bufferToFill is full, so the only branches are at its boundaries
+        for (int start = 0; start < numSamples;)
+        {
+            auto numToCopy = juce::jmin (numSamples - start, bufferToFill.getNumSamples() - fifoIndex);
+            juce::FloatVectorOperations::copy (bufferToFill.getWritePointer (0, fifoIndex), channelPtr + start, numToCopy);
+
+            fifoIndex += numToCopy;
+            start += numToCopy;
+
+            if (fifoIndex == bufferToFill.getNumSamples())
+            {
+                auto ok = audioBufferFifo.push (bufferToFill);
+
+                juce::ignoreUnused (ok);
+
+                fifoIndex = 0;
+            }
+        }
+    }
+
+    void prepare (int bufferSize)
+    {
+        prepared.set (false);
+        size.set (bufferSize);
+        
+        bufferToFill.setSize (1,             //channel
+                              bufferSize,    //num samples
+                              false,         //keepExistingContent
+                              true,          //clear extra space
+                              true);         //avoid reallocating
+        audioBufferFifo.prepare (1, bufferSize);
+        fifoIndex = 0;
+        prepared.set (true);
+    }
+    //==============================================================================
+    int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
+    bool isPrepared() const { return prepared.get(); }
+    int getSize() const { return size.get(); }
+    //==============================================================================
+    /**
+     Registers a reader, such as the editor's analyzer; update() only fills
+     the FIFO while there is one. Readers share the FIFO's single read side,
+     so attach, detach and pull from the message thread.
+     */
+    void attachConsumer()
+    {
+        //buffers left over from an earlier reader are stale, so drop them before the tap restarts
+        BlockType stale;
+        while (audioBufferFifo.pull (stale))
+            ;
+
+        ++consumers;
+    }
+
+    void detachConsumer()
+    {
+        jassert (consumers.get() > 0);
+        --consumers;
+    }
+
+    bool hasConsumer() const { return consumers.get() > 0; }
+
+    bool getAudioBuffer (BlockType& buf) { return audioBufferFifo.pull (buf); }
+private:
+    Channel channelToUse;
+    int fifoIndex = 0;
+    Fifo<BlockType> audioBufferFifo;
+    BlockType bufferToFill;
+    juce::Atomic<bool> prepared = false;
+    juce::Atomic<int> size = 0;
+    juce::Atomic<int> consumers = 0;
+
+    //audio thread only: whether the last update() had a reader to fill for
+    bool tapping = false;
+};
@@ -0,0 +1,491 @@
+/*
+  ==============================================================================
+
+    The filter chain as topology-preserving state variable filters, with the
+    parameters smoothed at a control rate so that sweeps do not zipper.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BiquadCascade.h"
+
+enum Smoothing
+{
+    Smoothing_Off,
+    Smoothing_8,
+    Smoothing_16,
+    Smoothing_32
+};
+
+/** Returns how many samples apart the smoothed chain recomputes its coefficients. */
+inline int getControlInterval (Smoothing smoothing) { return 4 << smoothing; }
+
+static constexpr int maxControlInterval = 32;
+
+/** What the smoothed chain is heading for. A cut of order 0, or a band that is not active, is switched off. */
+struct SvfChainSettings
+{
+    struct Band
+    {
+        BandType type = Band_Bell;
+        double frequency = 1000.0, quality = 1.0, gainInDecibels = 0.0;
+        bool active = false;
+    };
+
+    double lowCutFrequency = 20.0;
+    int lowCutOrder = 0;
+    CutType lowCutType = Cut_Butterworth;
+    std::array<Band, maxBands> bands;
+    double highCutFrequency = 20000.0;
+    int highCutOrder = 0;
+    CutType highCutType = Cut_Butterworth;
+};
+
+/**
+ The g, k and output mix of one TPT state variable filter, in the form
+ Zavalishin and Simper give it: the output is m0 * input + m1 * band + m2 * low.
+ With the same prewarping, every response here is exactly that of the
+ matching juce::dsp::IIR::Coefficients biquad. g is always given unscaled,
+ as tan (pi * frequency / sampleRate); the shelves scale it themselves.
+ */
+struct SvfParameters
+{
+    double g = 0, k = 2, m0 = 1, m1 = 0, m2 = 0;
+
+    static SvfParameters lowPass (double g, double Q)  { return { g, 1 / Q, 0, 0, 1 }; }
+    static SvfParameters highPass (double g, double Q) { return { g, 1 / Q, 1, -1 / Q, -1 }; }
+    static SvfParameters notch (double g, double Q)    { return { g, 1 / Q, 1, -1 / Q, 0 }; }
+
+    static SvfParameters bell (double g, double Q, double gainInDecibels)
+    {
+        auto A = std::pow (10.0, gainInDecibels / 40.0);
+        auto k = 1 / (Q * A);
+        return { g, k, 1, k * (A * A - 1), 0 };
+    }
+
+    static SvfParameters lowShelf (double g, double Q, double gainInDecibels)
+    {
+        auto A = std::pow (10.0, gainInDecibels / 40.0);
+        auto k = 1 / Q;
+        return { g / std::sqrt (A), k, 1, k * (A - 1), A * A - 1 };
+    }
+
+    static SvfParameters highShelf (double g, double Q, double gainInDecibels)
+    {
+        auto A = std::pow (10.0, gainInDecibels / 40.0);
+        auto k = 1 / Q;
+        return { g * std::sqrt (A), k, A * A, k * (1 - A) * A, 1 - A * A };
+    }
+
+    /** As makeTiltBiquad(): a high shelf turned down by half its gain. */
+    static SvfParameters tilt (double g, double Q, double gainInDecibels)
+    {
+        auto p = highShelf (g, Q, gainInDecibels);
+        auto pivotGain = std::pow (10.0, -gainInDecibels / 40.0);
+        return { p.g, p.k, p.m0 * pivotGain, p.m1 * pivotGain, p.m2 * pivotGain };
+    }
+
+    static SvfParameters band (BandType type, double g, double Q, double gainInDecibels)
+    {
+        switch (type)
+        {
+            case Band_LowShelf:  return lowShelf (g, Q, gainInDecibels);
+            case Band_HighShelf: return highShelf (g, Q, gainInDecibels);
+            case Band_Notch:     return notch (g, Q);
+            case Band_Tilt:      return tilt (g, Q, gainInDecibels);
+            case Band_Bell:      break;
+        }
+
+        return bell (g, Q, gainInDecibels);
+    }
+
+    SvfParameters interpolatedTowards (const SvfParameters& other, double proportion) const
+    {
+        auto lerp = [proportion] (double from, double to) { return from + proportion * (to - from); };
+        return { lerp (g, other.g), lerp (k, other.k), lerp (m0, other.m0), lerp (m1, other.m1), lerp (m2, other.m2) };
+    }
+};
+
+/**
+ Runs the low-cut, band and high-cut stages as TPT state variable filters.
+ The chain's parameters glide towards their targets, in octaves, decibels and
+ log Q, and every control interval the g, k and mix of each active section
+ are recomputed from them; bands that are switched off cost nothing. In
+ between they are interpolated linearly, sample by sample. Any positive g
+ and k give a stable TPT filter, so unlike a direct form biquad with
+ interpolated coefficients, the chain stays stable however fast it is modulated.
+
+ The coefficient ramp is worked out once per interval and shared by every
+ channel; channels are filtered in SIMD-width groups, one per lane, as in
+ MultiChannelBiquadCascade.
+ */
+template<typename SampleType>
+class SmoothedSvfChain
+{
+public:
+    using Register = juce::dsp::SIMDRegister<SampleType>;
+    static constexpr size_t numLanes = Register::SIMDNumElements;
+
+    void prepare (const juce::dsp::ProcessSpec& spec)
+    {
+        numChannels = spec.numChannels;
+        numGroups = isMono() ? 0 : (numChannels + numLanes - 1) / numLanes;
+        groupStates.resize (numGroups);
+        reset();
+    }
+
+    /** Clears the filters and jumps straight to the targets. */
+    void reset()
+    {
+        clear (monoStates);
+        for (auto& states : groupStates)
+            clear (states);
+
+        forEachSmoother ([] (juce::SmoothedValue<double>& smoother)
+        {
+            smoother.setCurrentAndTargetValue (smoother.getTargetValue());
+        });
+
+        samplesUntilUpdate = 0;
+        activeSlots = getActiveSlots (target);
+        current = getSectionTargets (activeSlots);
+    }
+
+    void setControlInterval (int newInterval)
+    {
+        jassert (juce::isPositiveAndNotGreaterThan (newInterval, maxControlInterval));
+        controlInterval = newInterval;
+        samplesUntilUpdate = 0;
+        resetSmoothers();
+    }
+
+    /** Sets where the chain glides to. A new sample rate is jumped to, not glided. */
+    void setTarget (const SvfChainSettings& newTarget, double newSampleRate)
+    {
+        target = newTarget;
+
+        lowCutPitch.setTargetValue (std::log2 (target.lowCutFrequency));
+        highCutPitch.setTargetValue (std::log2 (target.highCutFrequency));
+
+        for (size_t band = 0; band < target.bands.size(); ++band)
+        {
+            const auto& settings = target.bands[band];
+            auto& smoothers = bandSmoothers[band];
+
+            smoothers.pitch.setTargetValue (std::log2 (settings.frequency));
+            smoothers.gain.setTargetValue (settings.gainInDecibels);
+            smoothers.logQuality.setTargetValue (std::log2 (settings.quality));
+        }
+
+        if (newSampleRate != sampleRate)
+        {
+            sampleRate = newSampleRate;
+            resetSmoothers();
+            reset();
+        }
+    }
+
+    void process (const juce::dsp::AudioBlock<SampleType>& block)
+    {
+        jassert (block.getNumChannels() <= numChannels);
+
+        auto numSamples = block.getNumSamples();
+        size_t start = 0;
+
+        while (start < numSamples)
+        {
+            if (samplesUntilUpdate == 0)
+                updateRamp();
+
+            auto length = juce::jmin ((size_t) samplesUntilUpdate, numSamples - start);
+            auto segment = block.getSubBlock (start, length);
+            auto* rampPosition = ramp.data() + (controlInterval - samplesUntilUpdate);
+
+            if (isMono())
+            {
+                processSegment (segment.getChannelPointer (0), length, rampPosition, monoStates);
+            }
+            else
+            {
+                for (size_t group = 0; group < numGroups; ++group)
+                {
+                    auto firstChannel = group * numLanes;
+                    auto numGroupChannels = juce::jmin (numLanes, segment.getNumChannels() - firstChannel);
+
+                    interleaveChannels (segment, firstChannel, numGroupChannels, interleaved.data());
+                    processSegment (interleaved.data(), length, rampPosition, groupStates[group]);
+                    deinterleaveChannels (interleaved.data(), segment, firstChannel, numGroupChannels);
+                }
+            }
+
+            samplesUntilUpdate -= (int) length;
+            start += length;
+        }
+    }
+private:
+    //sections sit in fixed slots: the low-cut's, then one per band, then the high-cut's
+    static constexpr int numSlots = maxChainSections;
+
+    //a parameter takes this long to glide to a new target
+    static constexpr double smoothingTimeSeconds = 0.02;
+
+    /** What the inner loop needs for one section and sample. */
+    struct SectionTick
+    {
+        SampleType a1, a2, a3, m0, m1, m2;
+    };
+
+    template<typename VectorType>
+    struct SectionState
+    {
+        VectorType ic1eq, ic2eq;
+    };
+
+    template<typename VectorType>
+    using States = std::array<SectionState<VectorType>, numSlots>;
+
+    using SlotList = std::array<int, numSlots + 1>;
+    using SectionParameters = std::array<SvfParameters, numSlots>;
+
+    States<SampleType> monoStates;
+    std::vector<States<Register>> groupStates;
+    std::array<Register, maxControlInterval> interleaved;
+
+    //one row of ticks, for the active slots in order, per sample of the control interval
+    std::array<std::array<SectionTick, numSlots>, maxControlInterval> ramp;
+
+    struct BandSmoothers
+    {
+        juce::SmoothedValue<double> pitch, gain, logQuality;
+    };
+
+    juce::SmoothedValue<double> lowCutPitch, highCutPitch;
+    std::array<BandSmoothers, maxBands> bandSmoothers;
+    SvfChainSettings target;
+    SectionParameters current;
+
+    //the active slots, terminated by -1
+    SlotList activeSlots { -1 };
+
+    size_t numChannels = 0, numGroups = 0;
+    double sampleRate = 44100.0;
+    int controlInterval = getControlInterval (Smoothing_16), samplesUntilUpdate = 0;
+
+    bool isMono() const { return numChannels == 1; }
+
+    template<typename VectorType>
+    static void clear (States<VectorType>& states)
+    {
+        states.fill ({ splat<VectorType> (0), splat<VectorType> (0) });
+    }
+
+    template<typename Function>
+    void forEachSmoother (Function&& function)
+    {
+        function (lowCutPitch);
+        function (highCutPitch);
+
+        for (auto& smoothers : bandSmoothers)
+        {
+            function (smoothers.pitch);
+            function (smoothers.gain);
+            function (smoothers.logQuality);
+        }
+    }
+
+    void resetSmoothers()
+    {
+        forEachSmoother ([this] (juce::SmoothedValue<double>& smoother)
+        {
+            smoother.reset (sampleRate / controlInterval, smoothingTimeSeconds);
+        });
+    }
+
+    static SlotList getActiveSlots (const SvfChainSettings& settings)
+    {
+        SlotList slots;
+        size_t count = 0;
+
+        for (int i = 0; i < settings.lowCutOrder / 2; ++i)
+            slots[count++] = getLowCutSlot (i);
+
+        for (int band = 0; band < maxBands; ++band)
+            if (settings.bands[(size_t) band].active)
+                slots[count++] = getBandSlot (band);
+
+        for (int i = 0; i < settings.highCutOrder / 2; ++i)
+            slots[count++] = getHighCutSlot (i);
+
+        slots[count] = -1;
+        return slots;
+    }
+
+    static bool isBandSlot (int slot) { return slot >= getBandSlot (0) && slot < getHighCutSlot (0); }
+
+    bool isActive (int slot) const
+    {
+        for (size_t i = 0; activeSlots[i] >= 0; ++i)
+            if (activeSlots[i] == slot)
+                return true;
+
+        return false;
+    }
+
+    void switchIn (int slot, const SectionParameters& next)
+    {
+        current[(size_t) slot] = next[(size_t) slot];
+        monoStates[(size_t) slot] = { 0, 0 };
+
+        for (auto& states : groupStates)
+            states[(size_t) slot] = { splat<Register> (0), splat<Register> (0) };
+    }
+
+    double getG (double pitch) const
+    {
+        //keep clear of Nyquist, where the prewarping runs away
+        auto frequency = juce::jmin (std::exp2 (pitch), 0.49 * sampleRate);
+        return std::tan (juce::MathConstants<double>::pi * frequency / sampleRate);
+    }
+
+    /** Returns the given slots' sections for the smoothers' current values. The others are left as they are. */
+    SectionParameters getSectionTargets (const SlotList& slots) const
+    {
+        SectionParameters sections;
+
+        auto lowCutG = getG (lowCutPitch.getCurrentValue());
+        auto highCutG = getG (highCutPitch.getCurrentValue());
+
+        for (size_t i = 0; slots[i] >= 0; ++i)
+        {
+            auto slot = slots[i];
+            auto& section = sections[(size_t) slot];
+
+            if (slot < getBandSlot (0))
+            {
+                section = SvfParameters::highPass (lowCutG, getCutSectionQ<double> (target.lowCutType, slot, target.lowCutOrder));
+            }
+            else if (slot >= getHighCutSlot (0))
+            {
+                auto cutSection = slot - getHighCutSlot (0);
+                section = SvfParameters::lowPass (highCutG, getCutSectionQ<double> (target.highCutType, cutSection, target.highCutOrder));
+            }
+            else
+            {
+                auto band = (size_t) (slot - getBandSlot (0));
+                const auto& smoothers = bandSmoothers[band];
+
+                //JUCE's bell and shelves keep their frequency above 2 Hz, and so do these
+                auto g = getG (juce::jmax (smoothers.pitch.getCurrentValue(), 1.0));
+                section = SvfParameters::band (target.bands[band].type, g,
+                                               std::exp2 (smoothers.logQuality.getCurrentValue()),
+                                               smoothers.gain.getCurrentValue());
+            }
+        }
+
+        return sections;
+    }
+
+    /** Steps the smoothers one control interval on and fills in the ramp towards where they land. */
+    void updateRamp()
+    {
+        auto nextSlots = getActiveSlots (target);
+
+        //a band that has just been switched in jumps to its target rather than gliding from stale values
+        for (size_t i = 0; nextSlots[i] >= 0; ++i)
+        {
+            if (isBandSlot (nextSlots[i]) && ! isActive (nextSlots[i]))
+            {
+                auto& smoothers = bandSmoothers[(size_t) (nextSlots[i] - getBandSlot (0))];
+
+                for (auto* smoother : { &smoothers.pitch, &smoothers.gain, &smoothers.logQuality })
+                    smoother->setCurrentAndTargetValue (smoother->getTargetValue());
+            }
+        }
+
+        //only the active bands glide; the others are jumped on when they come back
+        lowCutPitch.getNextValue();
+        highCutPitch.getNextValue();
+
+        for (size_t i = 0; nextSlots[i] >= 0; ++i)
+        {
+            if (isBandSlot (nextSlots[i]))
+            {
+                auto& smoothers = bandSmoothers[(size_t) (nextSlots[i] - getBandSlot (0))];
+
+                for (auto* smoother : { &smoothers.pitch, &smoothers.gain, &smoothers.logQuality })
+                    smoother->getNextValue();
+            }
+        }
+
+        auto next = getSectionTargets (nextSlots);
+
+        //a section that has just been switched in starts from silence and from its target
+        for (size_t i = 0; nextSlots[i] >= 0; ++i)
+        {
+            if (! isActive (nextSlots[i]))
+                switchIn (nextSlots[i], next);
+        }
+
+        activeSlots = nextSlots;
+
+        for (int n = 0; n < controlInterval; ++n)
+        {
+            auto proportion = (n + 1) / (double) controlInterval;
+
+            for (size_t i = 0; activeSlots[i] >= 0; ++i)
+            {
+                auto slot = (size_t) activeSlots[i];
+                auto p = current[slot].interpolatedTowards (next[slot], proportion);
+
+                auto a1 = 1 / (1 + p.g * (p.g + p.k));
+                auto a2 = p.g * a1;
+                auto a3 = p.g * a2;
+
+                ramp[(size_t) n][i] = { (SampleType) a1, (SampleType) a2, (SampleType) a3,
+                                       (SampleType) p.m0, (SampleType) p.m1, (SampleType) p.m2 };
+            }
+        }
+
+        current = next;
+        samplesUntilUpdate = controlInterval;
+    }
+
+    template<typename VectorType>
+    void processSegment (VectorType* samples, size_t numSamples,
+                         const std::array<SectionTick, numSlots>* rampPosition, States<VectorType>& states) const
+    {
+        const auto two = splat<VectorType> (2);
+
+        for (size_t n = 0; n < numSamples; ++n)
+        {
+            auto input = samples[n];
+            const auto& ticks = rampPosition[n];
+
+            for (size_t i = 0; activeSlots[i] >= 0; ++i)
+            {
+                const auto& c = ticks[i];
+                auto& state = states[(size_t) activeSlots[i]];
+
+                auto v3 = input - state.ic2eq;
+                auto v1 = state.ic1eq * splat<VectorType> (c.a1) + v3 * splat<VectorType> (c.a2);
+                auto v2 = state.ic2eq + state.ic1eq * splat<VectorType> (c.a2) + v3 * splat<VectorType> (c.a3);
+                state.ic1eq = v1 * two - state.ic1eq;
+                state.ic2eq = v2 * two - state.ic2eq;
+
+                input = input * splat<VectorType> (c.m0) + v1 * splat<VectorType> (c.m1) + v2 * splat<VectorType> (c.m2);
+            }
+
+            samples[n] = input;
+        }
+
+        for (size_t i = 0; activeSlots[i] >= 0; ++i)
+        {
+            auto& state = states[(size_t) activeSlots[i]];
+            snapToZero (state.ic1eq);
+            snapToZero (state.ic2eq);
+        }
+    }
+};
@@ -0,0 +1,260 @@
+/*
+  ==============================================================================
+
+    A persistent pool of threads that share out the channel groups of an
+    offline render, and the one pool every instance in the process shares.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ Runs a job of numbered tasks on the calling thread and a fixed set of
+ workers, which are started once and then wait between jobs, so no thread is
+ created per block.
+
+ Each thread starts with an even share of the task numbers, as a range it
+ takes from the front of. One that runs out steals from the back of the
+ largest range left, so a slow task does not hold the others up. Claiming is
+ a compare-and-swap on the range, with no lock.
+
+ Waking a worker only signals it, which never waits, so any thread may do
+ it. run() then waits for the workers to finish, which a realtime thread
+ must not, so only offline rendering hands jobs to the pool. A worker with
+ no job sleeps until it is signalled, so an idle pool costs nothing but its
+ threads.
+
+ The pool runs one job at a time. A caller that finds it busy with another's
+ runs its tasks alone rather than wait, so instances can share a pool.
+ */
+class WorkStealingPool
+{
+public:
+    WorkStealingPool() = default;
+    ~WorkStealingPool() { stop(); }
+
+    /** Starts numWorkers threads; the caller of run() makes one more. */
+    void start (int numWorkers)
+    {
+        stop();
+
+        for (int i = 0; i < numWorkers; ++i)
+            workers.push_back (std::make_unique<Worker> (*this, i + 1));
+
+        ranges = std::vector<TaskRange> (workers.size() + 1);
+
+        for (auto& worker : workers)
+            worker->startThread();
+    }
+
+    void stop()
+    {
+        for (auto& worker : workers)
+        {
+            worker->signalThreadShouldExit();
+            worker->notify();
+        }
+
+        for (auto& worker : workers)
+            worker->stopThread (1000);
+
+        workers.clear();
+    }
+
+    /** Returns how many threads run() shares tasks between, including its caller: the range of the index passed to each task. */
+    int getNumThreads() const { return (int) workers.size() + 1; }
+
+    /**
+     Calls task (taskIndex, threadIndex) for every taskIndex below numTasks,
+     across the pool, and returns once all have finished. A thread runs its
+     tasks one at a time, so anything indexed by threadIndex is its alone.
+     */
+    template<typename Task>
+    void run (int numTasks, Task&& task)
+    {
+        const juce::SpinLock::ScopedTryLockType lock (jobLock);
+
+        if (! lock.isLocked() || workers.empty() || numTasks <= 1)
+        {
+            for (int i = 0; i < numTasks; ++i)
+                task (i, 0);
+
+            return;
+        }
+
+        runTask = [] (void* context, int taskIndex, int threadIndex)
+        {
+            (*static_cast<std::remove_reference_t<Task>*> (context)) (taskIndex, threadIndex);
+        };
+        taskContext = &task;
+        remaining.store (numTasks, std::memory_order_relaxed);
+
+        auto numThreads = ranges.size();
+        for (size_t i = 0; i < numThreads; ++i)
+        {
+            auto begin = (juce::uint32) ((size_t) numTasks * i / numThreads);
+            auto end = (juce::uint32) ((size_t) numTasks * (i + 1) / numThreads);
+            ranges[i].tasks.store (pack (begin, end), std::memory_order_release);
+        }
+
+        generation.fetch_add (1, std::memory_order_release);
+
+        for (auto& worker : workers)
+            worker->notify();
+
+        runTasks (0);
+
+        //the last tasks may still be running on the workers
+        while (remaining.load (std::memory_order_acquire) > 0)
+            std::this_thread::yield();
+    }
+private:
+    //the next task to take and one past the last, packed so a single compare-and-swap claims from either end
+    struct alignas (64) TaskRange
+    {
+        std::atomic<juce::uint64> tasks { 0 };
+    };
+
+    struct Worker : juce::Thread
+    {
+        Worker (WorkStealingPool& ownerToUse, int indexToUse)
+            : juce::Thread ("SimpleEQ Render Worker"), owner (ownerToUse), index (indexToUse)
+        {
+        }
+
+        void run() override
+        {
+            auto seenGeneration = owner.generation.load (std::memory_order_acquire);
+
+            while (! threadShouldExit())
+            {
+                auto current = owner.generation.load (std::memory_order_acquire);
+
+                if (current == seenGeneration)
+                {
+                    //jobs come a segment at a time while a render runs, so spin briefly before sleeping
+                    for (int spin = 0; spin < spinsBeforeWaiting && current == seenGeneration; ++spin)
+                    {
+                        std::this_thread::yield();
+                        current = owner.generation.load (std::memory_order_acquire);
+                    }
+
+                    //run() notifies after bumping the generation, and a notify is kept until waited on, so none is missed
+                    if (current == seenGeneration)
+                    {
+                        wait (-1);
+                        continue;
+                    }
+                }
+
+                seenGeneration = current;
+                owner.runTasks ((size_t) index);
+            }
+        }
+
+        static constexpr int spinsBeforeWaiting = 1000;
+
+        WorkStealingPool& owner;
+        const int index;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<TaskRange> ranges;
+
+    juce::SpinLock jobLock;
+    std::atomic<juce::uint32> generation { 0 };
+    std::atomic<int> remaining { 0 };
+    void (*runTask) (void*, int, int) = nullptr;
+    void* taskContext = nullptr;
+
+    static juce::uint64 pack (juce::uint32 begin, juce::uint32 end) { return ((juce::uint64) begin << 32) | end; }
+    static juce::uint32 beginOf (juce::uint64 range) { return (juce::uint32) (range >> 32); }
+    static juce::uint32 endOf (juce::uint64 range) { return (juce::uint32) range; }
+
+    void runTasks (size_t thread)
+    {
+        for (;;)
+        {
+            int taskIndex;
+            if (! takeOwnTask (thread, taskIndex) && ! stealTask (thread, taskIndex))
+                return;
+
+            //the range the task came from was filled after these were set
+            runTask (taskContext, taskIndex, (int) thread);
+            remaining.fetch_sub (1, std::memory_order_acq_rel);
+        }
+    }
+
+    bool takeOwnTask (size_t thread, int& taskIndex)
+    {
+        auto& own = ranges[thread].tasks;
+        auto range = own.load (std::memory_order_acquire);
+
+        while (beginOf (range) < endOf (range))
+        {
+            if (own.compare_exchange_weak (range, pack (beginOf (range) + 1, endOf (range)), std::memory_order_acq_rel))
+            {
+                taskIndex = (int) beginOf (range);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool stealTask (size_t thread, int& taskIndex)
+    {
+        for (;;)
+        {
+            //the victim with the most left, which is the least likely to run out before the steal lands
+            size_t victim = thread;
+            juce::uint32 mostLeft = 0;
+
+            for (size_t i = 0; i < ranges.size(); ++i)
+            {
+                auto range = ranges[i].tasks.load (std::memory_order_acquire);
+                auto left = endOf (range) > beginOf (range) ? endOf (range) - beginOf (range) : 0;
+
+                if (i != thread && left > mostLeft)
+                {
+                    victim = i;
+                    mostLeft = left;
+                }
+            }
+
+            if (mostLeft == 0)
+                return false;
+
+            auto& tasks = ranges[victim].tasks;
+            auto range = tasks.load (std::memory_order_acquire);
+            auto begin = beginOf (range), end = endOf (range);
+
+            if (begin >= end)
+                continue;
+
+            //a single task, so nothing a thief holds can outlive the job it took it from
+            if (! tasks.compare_exchange_strong (range, pack (begin, end - 1), std::memory_order_acq_rel))
+                continue;
+
+            taskIndex = (int) (end - 1);
+            return true;
+        }
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (WorkStealingPool)
+};
+
+/**
+ The process's render pool, with a worker for every core but the caller's.
+ Held through a juce::SharedResourcePointer, so however many instances are
+ loaded, the process has one set of workers. Instances only hold it while
+ multithreaded offline rendering is on, so it is started by the first to
+ turn that on and stopped when the last turns it off.
+ */
+struct SharedRenderPool : WorkStealingPool
+{
+    SharedRenderPool() { start (juce::jmax (0, juce::SystemStats::getNumCpus() - 1)); }
+};